@@ -1,5 +1,6 @@
 #include <cstdio>
 #include <cmath>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <algorithm>
@@ -12,12 +13,17 @@
 
 #include "shader.hpp"
 #include "shader_program.hpp"
+#include "program_binary_cache.hpp"
 #include "vertex_array.hpp"
 #include "buffer.hpp"
 #include "texture.hpp"
 #include "window.hpp"
 #include "camera.hpp"
 #include "input.hpp"
+#include "frame_bench.hpp"
+#include "profiler.hpp"
+#include "render_queue.hpp"
+#include "frustum.hpp"
 #include "utils.hpp"
 
 struct Vertex {
@@ -107,18 +113,23 @@ constexpr GLuint window_w = 800, window_h = 800;
 Window *g_window;
 Camera g_camera{{0.0f, 0.0f, 3.0f}, {0.0f, 0.0f, -1.0f}};
 GLfloat g_mix_factor = 0.0f;
+RenderQueue g_render_queue;
 
 int main(int argc, char **argv) {
     glfwInit();
     g_window = new Window(window_w, window_h, "yeet");
     g_window->set_vsync(true);
 
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+    if (!g_window->load_gl()) {
         std::cout << "Failed to initialize GLEW" << std::endl;
         return -1;
     }
 
-    glfwSetInputMode(g_window->get_window(), GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    ProgramBinaryCache::set_default_directory(".cache");
+
+    FrameBench bench{argc, argv, *g_window, CameraPath::orbit({0.0f, 0.0f, -6.0f}, 12.0f, 3.0f, 8, 10.0)};
+
+    g_window->set_cursor_mode(GLFW_CURSOR_DISABLED);
     g_window->set_viewport(window_w, window_h);
     g_camera.set_viewport_dims({window_w, window_h});
     glEnable(GL_DEPTH_TEST);
@@ -161,11 +172,20 @@ int main(int argc, char **argv) {
     VertexBuffer vbo;
 
     vbo.set_data(vertices, sizeof(vertices));
-    vbo.set_layout({
+    GLuint nb_attribs = vao.set_layout({
         BufferElement::Float3,
         BufferElement::Float2,
         BufferElement::Float2,
-    });
+    }, vbo);
+
+    // Per-cube model matrices, refreshed every frame
+    constexpr std::size_t nb_cubes = SIZEOF_ARRAY(cube_params);
+    glm::mat4 models[nb_cubes];
+    Aabb cube_bounds[nb_cubes];
+    std::uint8_t cube_visible[nb_cubes];
+    const Aabb cube_aabb = Aabb::from_points(vertices, SIZEOF_ARRAY(vertices), sizeof(Vertex));
+    StreamBuffer<GL_ARRAY_BUFFER> instance_stream{sizeof(models)};
+    vao.set_layout({{BufferElement::Mat4}, 1}, instance_stream, nb_attribs);
 
     Texture2d tex1{"data/191407_1308820425_orig.jpg", 0};
     Texture2d tex2{"data/default_icon.jpg",           1};
@@ -175,24 +195,54 @@ int main(int argc, char **argv) {
     program.set_value("tex_1", 0);
     program.set_value("tex_2", 1);
 
+    DrawItem cube_item = { &program, vao.get_handle(), {tex1.get_handle(), tex2.get_handle()} };
+    cube_item.count        = 36;
+    cube_item.nb_instances = nb_cubes;
+    cube_item.set_uniforms = [](ShaderProgram &program) {
+        program.set_value("factor",    g_mix_factor);
+        program.set_value("view_proj", g_camera.get_view_proj());
+    };
+
     while(!g_window->get_should_close()){
+        bench.begin_frame(g_camera);
+        Profiler::begin_frame();
         glClearColor(0.18f, 0.20f, 0.25f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        program.set_value("factor",    g_mix_factor);
-        program.set_value("view_proj", g_camera.get_view_proj());
+        {
+            PROFILE_ZONE("Cubes");
+            for (std::size_t i = 0; i < nb_cubes; ++i) {
+                GLfloat rot = (i % 3 == 0) ? 20.0f * i + 1 : Window::get_time();
+                models[i] = glm::rotate(glm::translate(glm::mat4(1.0f), cube_params[i].pos), rot, cube_params[i].rot_axis);
+                cube_bounds[i] = cube_aabb.transform(models[i]);
+            }
+            g_camera.get_frustum().cull(cube_bounds, nb_cubes, cube_visible);
+            cube_item.nb_instances = compact_visible(models, cube_visible, nb_cubes);
+            if (cube_item.nb_instances) {
+                std::memcpy(instance_stream.begin(), models, cube_item.nb_instances * sizeof(glm::mat4));
+                std::size_t instance_off = instance_stream.end();
+                vao.set_vertex_buffer({{BufferElement::Mat4}, 1}, instance_stream, nb_attribs, instance_off);
+                g_render_queue.submit(cube_item);
+            }
+        }
 
-        for (std::size_t i = 0; i < 10; ++i) {
-            GLfloat rot = (i % 3 == 0) ? 20.0f * i + 1 : glfwGetTime();
-            glm::mat4 model = glm::translate(glm::mat4(1.0f), cube_params[i].pos);
-            model = glm::rotate(model, rot, cube_params[i].rot_axis);
-            program.set_value("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+        {
+            PROFILE_ZONE("Render queue");
+            g_render_queue.flush();
+            instance_stream.fence();
         }
 
-        g_window->update();
+        {
+            PROFILE_ZONE("Present");
+            g_window->update();
+        }
+        Profiler::end_frame();
+        bench.end_frame();
     }
 
+    bench.report("1-basics");
+    Profiler::write_trace();
+
     glfwTerminate();
     return 0;
 }
@@ -35,9 +35,13 @@ out vec4 out_color;
 
 uniform vec3        u_view_pos;
 uniform material_t  u_material;
-uniform pt_light_t  u_pt_light[5];
-uniform dir_light_t u_dir_light;
-uniform spotlight_t u_spotlight;
+
+// Mirrored by LightingBlock in common/lighting.hpp
+layout (std140) uniform lighting_block {
+    pt_light_t  u_pt_light[5];
+    dir_light_t u_dir_light;
+    spotlight_t u_spotlight;
+};
 
 vec3 calc_light(light_t light, float amb, float diff, float spec);
 vec3 calc_dir_light(dir_light_t light, vec3 view_dir, vec3 normal);
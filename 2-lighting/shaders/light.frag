@@ -1,9 +1,9 @@
 #version 330 core
 
-out vec4 out_color;
+in vec3 light_col;
 
-uniform vec3 u_light_col;
+out vec4 out_color;
 
 void main() {
-    out_color = vec4(u_light_col, 1.0f);
+    out_color = vec4(light_col, 1.0f);
 }
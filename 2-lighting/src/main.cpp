@@ -1,5 +1,6 @@
 #include <cstdio>
 #include <cmath>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <algorithm>
@@ -12,12 +13,21 @@
 
 #include "shader.hpp"
 #include "shader_program.hpp"
+#include "program_binary_cache.hpp"
 #include "vertex_array.hpp"
 #include "buffer.hpp"
+#include "lighting.hpp"
+#include "normal_matrix.hpp"
 #include "texture.hpp"
+#include "texture_loader.hpp"
+#include "thread_pool.hpp"
 #include "window.hpp"
 #include "camera.hpp"
 #include "input.hpp"
+#include "frame_bench.hpp"
+#include "profiler.hpp"
+#include "render_queue.hpp"
+#include "frustum.hpp"
 #include "utils.hpp"
 
 struct Vertex {
@@ -116,22 +126,33 @@ PointLightParams pt_light_params[] = {
     { glm::vec3(0.3f, 0.8f, 0.5f), 2.0f, 0.5f, 0.8f, 0.6f },
 };
 
+struct LightInstance {
+    glm::mat4 model;
+    glm::vec3 color;
+};
+
 constexpr GLuint window_w = 800, window_h = 800;
+constexpr double texture_budget_ms = 2.0;
 
 Window *g_window;
 Camera g_camera{{0.0f, 0.0f, 5.0f}, {0.0f, 0.0f, -1.0f}};
+RenderQueue g_render_queue;
 
 int main(int argc, char **argv) {
     glfwInit();
     g_window = new Window(window_w, window_h, "yeet");
     g_window->set_vsync(true);
 
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+    if (!g_window->load_gl()) {
         std::cout << "Failed to initialize GLEW" << std::endl;
         return -1;
     }
 
-    glfwSetInputMode(g_window->get_window(), GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    ProgramBinaryCache::set_default_directory(".cache");
+
+    FrameBench bench{argc, argv, *g_window, CameraPath::orbit({0.0f, 0.0f, -6.0f}, 12.0f, 3.0f, 8, 10.0)};
+
+    g_window->set_cursor_mode(GLFW_CURSOR_DISABLED);
     g_window->set_viewport(window_w, window_h);
     g_camera.set_viewport_dims({window_w, window_h});
     glEnable(GL_DEPTH_TEST);
@@ -151,6 +172,14 @@ int main(int argc, char **argv) {
         if ((e.get_key() == GLFW_KEY_ESCAPE) || (e.get_key() == GLFW_KEY_ENTER))
             g_window->set_should_close(true);
     });
+    input_man.register_callback<KeyPressedEvent>([](KeyPressedEvent &e) {
+        if (e.get_key() != GLFW_KEY_U) return;
+        auto &stats = ShaderProgram::get_uniform_stats();
+        std::cout << "Uniform updates last frame: " << stats.issued << " issued, " << stats.elided << " elided\n";
+        auto &queue_stats = g_render_queue.get_stats();
+        std::cout << "Render queue last frame: " << queue_stats.nb_items << " items, " << queue_stats.get_nb_binds()
+            << " binds, " << queue_stats.get_nb_binds_avoided() << " avoided\n";
+    });
     input_man.register_callback<MouseMovedEvent>([](MouseMovedEvent &e) {
         g_camera.rotate(e.get_x(), e.get_y());
     });
@@ -164,39 +193,70 @@ int main(int argc, char **argv) {
 
     VertexShader vert_sh{"shaders/cube.vert"};
     ShaderProgram program{vert_sh, FragmentShader{"shaders/cube.frag"}};
-    ShaderProgram light_program{vert_sh, FragmentShader{"shaders/light.frag"}};
+    ShaderProgram light_program{VertexShader{"shaders/light.vert"}, FragmentShader{"shaders/light.frag"}};
+
+    constexpr std::size_t nb_cubes = SIZEOF_ARRAY(cube_params), nb_lights = SIZEOF_ARRAY(pt_light_params);
+    glm::mat4 cube_models[nb_cubes];
+    LightInstance light_instances[nb_lights];
+
+    // Culling visibility, shared by the cubes and the lights
+    Aabb bounds[std::max(nb_cubes, nb_lights)];
+    std::uint8_t visible[std::max(nb_cubes, nb_lights)];
+    const Aabb cube_aabb = Aabb::from_points(vertices, SIZEOF_ARRAY(vertices), sizeof(Vertex));
 
     VertexArray vao;
     VertexBuffer vbo;
 
     vbo.set_data(vertices, sizeof(vertices));
-    vbo.set_layout({
+    GLuint nb_attribs = vao.set_layout({
         BufferElement::Float3,
         BufferElement::Float3,
         BufferElement::Float2,
-    });
+    }, vbo);
+
+    // Per-frame instance data: cube models, cube normal matrices, then lights
+    // The attributes are pointed at the region written this frame, before flushing the render queue
+    constexpr std::size_t cube_normals_off = nb_cubes * sizeof(glm::mat4);
+    constexpr std::size_t lights_off       = cube_normals_off + nb_cubes * sizeof(glm::mat3);
+    StreamBuffer<GL_ARRAY_BUFFER> instance_stream{lights_off + sizeof(light_instances)};
+    GLuint nb_cube_attribs = vao.set_layout({{BufferElement::Mat4}, 1}, instance_stream, nb_attribs);
+    vao.set_layout({{BufferElement::Mat3}, 1}, instance_stream, nb_cube_attribs, cube_normals_off);
 
     VertexArray light_vao;
-    vbo.set_layout({
+    light_vao.set_layout({
         BufferElement::Float3,
         BufferElement::Float3,
         BufferElement::Float2,
-    });
+    }, vbo);
+    light_vao.set_layout({{BufferElement::Mat4, BufferElement::Float3}, 1}, instance_stream, nb_attribs, lights_off);
+
+    ThreadPool pool;
+    TextureLoader tex_loader{pool, texture_budget_ms};
+    auto diff_tex_1   = tex_loader.load("data/marble_01_diff_1k.png");
+    auto spec_tex_1   = tex_loader.load("data/marble_01_spec_1k.png");
+    auto diff_tex_2   = tex_loader.load("data/green_metal_rust_diff_1k.png", 0);
+    auto spec_tex_2   = tex_loader.load("data/green_metal_rust_spec_1k.png", 1);
+    auto emission_tex = tex_loader.load("data/lava-emission.png",          2);
+
+    DrawItem cube_item = { &program, vao.get_handle() };
+    cube_item.count        = 36;
+    cube_item.nb_instances = nb_cubes;
+    cube_item.set_uniforms = [](ShaderProgram &program) {
+        program.set_value("u_view_proj", g_camera.get_view_proj());
+        program.set_value("u_view_pos",  g_camera.get_pos());
+    };
 
-    Texture2d diff_tex_1{"data/marble_01_diff_1k.png"};
-    Texture2d spec_tex_1{"data/marble_01_spec_1k.png"};
-    Texture2d diff_tex_2{"data/green_metal_rust_diff_1k.png", 0};
-    Texture2d spec_tex_2{"data/green_metal_rust_spec_1k.png", 1};
-    Texture2d emission_tex{"data/lava-emission.png",          2};
+    DrawItem light_item = { &light_program, light_vao.get_handle() };
+    light_item.count        = 36;
+    light_item.nb_instances = nb_lights;
+    light_item.set_uniforms = [](ShaderProgram &program) {
+        program.set_value("u_view_proj", g_camera.get_view_proj());
+    };
 
-    input_man.register_callback<KeyPressedEvent>([&diff_tex_1, &spec_tex_1, &diff_tex_2, &spec_tex_2](KeyPressedEvent &e) {
+    bool tex_to_use = false;
+    input_man.register_callback<KeyPressedEvent>([&tex_to_use](KeyPressedEvent &e) {
         if (e.get_key() != GLFW_KEY_Q) return;
-        static bool tex_to_use;
         tex_to_use ^= 1;
-        Texture2d<>::active(0);
-        (tex_to_use ? diff_tex_1 : diff_tex_2).bind();
-        Texture2d<>::active(1);
-        (tex_to_use ? spec_tex_1 : spec_tex_2).bind();
     });
 
     glm::vec3 dir_light_col = glm::vec3(0.9f, 0.1f, 0.2f);
@@ -208,67 +268,120 @@ int main(int argc, char **argv) {
     program.set_value("u_material.emission",  2);
     program.set_value("u_material.shininess", 32.0f);
 
-    for (std::size_t i = 0; i < 5; ++i) {
-        std::string idx = std::to_string(i);
-        program.set_value("u_pt_light[" + idx + "].light.ambient",  0.1f  * pt_light_params[i].color);
-        program.set_value("u_pt_light[" + idx + "].light.diffuse",  0.5f  * pt_light_params[i].color);
-        program.set_value("u_pt_light[" + idx + "].light.specular", 0.7f  * pt_light_params[i].color);
-        program.set_value("u_pt_light[" + idx + "].constant",       1.0f);
-        program.set_value("u_pt_light[" + idx + "].linear",         0.09f);
-        program.set_value("u_pt_light[" + idx + "].quadratic",      0.032f);
+    constexpr GLuint lighting_binding = 0;
+    program.bind_uniform_block(LightingBlock::name, lighting_binding);
+    UniformBuffer<LightingBlock> lighting_ubo{lighting_binding};
+
+    auto &lighting = lighting_ubo.get();
+    for (std::size_t i = 0; i < LightingBlock::nb_pt_lights; ++i) {
+        auto &pt_light = lighting.pt_lights[i];
+        pt_light.light.ambient  = 0.1f  * pt_light_params[i].color;
+        pt_light.light.diffuse  = 0.5f  * pt_light_params[i].color;
+        pt_light.light.specular = 0.7f  * pt_light_params[i].color;
+        pt_light.constant       = 1.0f;
+        pt_light.linear         = 0.09f;
+        pt_light.quadratic      = 0.032f;
     }
 
-    program.set_value("u_dir_light.light.ambient",   0.1f * dir_light_col);
-    program.set_value("u_dir_light.light.diffuse",   0.3f * dir_light_col);
-    program.set_value("u_dir_light.light.specular",         dir_light_col);
-    program.set_value("u_dir_light.direction",      -0.2f, -1.0f, -0.3f);
+    lighting.dir_light.light.ambient  = 0.1f * dir_light_col;
+    lighting.dir_light.light.diffuse  = 0.3f * dir_light_col;
+    lighting.dir_light.light.specular =        dir_light_col;
+    lighting.dir_light.direction      = glm::vec3(-0.2f, -1.0f, -0.3f);
+
+    lighting.spotlight.light.diffuse  = spotlight_col;
+    lighting.spotlight.light.specular = spotlight_col;
+    lighting.spotlight.inner_cutoff   = glm::cos(glm::radians(9.5f));
+    lighting.spotlight.outer_cutoff   = glm::cos(glm::radians(12.5f));
 
-    program.set_value("u_spotlight.light.diffuse",   spotlight_col);
-    program.set_value("u_spotlight.light.specular",  spotlight_col);
-    program.set_value("u_spotlight.inner_cutoff",    glm::cos(glm::radians(9.5f)));
-    program.set_value("u_spotlight.outer_cutoff",    glm::cos(glm::radians(12.5f)));
+    // Frame times would otherwise depend on how fast textures stream in
+    if (bench.is_enabled())
+        while (!tex_loader.is_idle())
+            tex_loader.update();
 
     glm::vec3 array_pos[5];
     while(!g_window->get_should_close()) {
+        bench.begin_frame(g_camera);
+        Profiler::begin_frame();
+        {
+            PROFILE_ZONE("Texture streaming");
+            tex_loader.update();
+        }
+
+        ShaderProgram::reset_uniform_stats();
+
         glClearColor(0.18f, 0.20f, 0.25f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        vao.bind();
-        program.bind();
-        program.set_value("u_view_proj",           g_camera.get_view_proj());
-        program.set_value("u_view_pos",            g_camera.get_pos());
-        program.set_value("u_spotlight.position",  g_camera.get_pos());
-        program.set_value("u_spotlight.direction", g_camera.get_front());
-        for (std::size_t i = 0; i < 5; ++i) {
-            array_pos[i] = glm::vec3(
-                pt_light_params[i].radius * glm::cos(pt_light_params[i].speed_x * glfwGetTime()),
-                pt_light_params[i].radius * glm::cos(pt_light_params[i].speed_y * glfwGetTime()),
-                pt_light_params[i].radius * glm::sin(pt_light_params[i].speed_z * glfwGetTime())
-            );
-            program.set_value("u_pt_light[" + std::to_string(i) + "].position", array_pos[i]);
+        auto *instance_data = (std::uint8_t *)instance_stream.begin();
+
+        {
+            PROFILE_ZONE("Cubes");
+            lighting.spotlight.position  = g_camera.get_pos();
+            lighting.spotlight.direction = g_camera.get_front();
+            for (std::size_t i = 0; i < 5; ++i) {
+                array_pos[i] = glm::vec3(
+                    pt_light_params[i].radius * glm::cos(pt_light_params[i].speed_x * Window::get_time()),
+                    pt_light_params[i].radius * glm::cos(pt_light_params[i].speed_y * Window::get_time()),
+                    pt_light_params[i].radius * glm::sin(pt_light_params[i].speed_z * Window::get_time())
+                );
+                lighting.pt_lights[i].position = array_pos[i];
+            }
+            lighting_ubo.update();
+
+            for (std::size_t i = 0; i < nb_cubes; ++i) {
+                GLfloat rot = (i % 3 == 0) ? 20.0f * i + 1 : Window::get_time();
+                cube_models[i] = glm::rotate(glm::translate(glm::mat4(1.0f), cube_params[i].pos), rot, cube_params[i].rot_axis);
+                bounds[i] = cube_aabb.transform(cube_models[i]);
+            }
+            g_camera.get_frustum().cull(bounds, nb_cubes, visible);
+            std::size_t nb_visible = cube_item.nb_instances = compact_visible(cube_models, visible, nb_cubes);
+            std::memcpy(instance_data, cube_models, nb_visible * sizeof(glm::mat4));
+            compute_normal_matrices(cube_models, (glm::mat3 *)(instance_data + cube_normals_off), nb_visible);
+
+            cube_item.textures = {
+                (tex_to_use ? diff_tex_1 : diff_tex_2)->get_handle(),
+                (tex_to_use ? spec_tex_1 : spec_tex_2)->get_handle(),
+                emission_tex->get_handle(),
+            };
+            if (nb_visible)
+                g_render_queue.submit(cube_item);
         }
 
-        for (std::size_t i = 0; i < 10; ++i) {
-            GLfloat rot = (i % 3 == 0) ? 20.0f * i + 1 : glfwGetTime();
-            glm::mat4 model = glm::translate(glm::mat4(1.0f), cube_params[i].pos);
-            model = glm::rotate(model, rot, cube_params[i].rot_axis);
-            program.set_value("u_model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+        {
+            PROFILE_ZONE("Lights");
+            for (std::size_t i = 0; i < nb_lights; ++i) {
+                light_instances[i] = { glm::scale(glm::translate(glm::mat4(1.0f), array_pos[i]), glm::vec3(0.3f)), pt_light_params[i].color };
+                bounds[i] = cube_aabb.transform(light_instances[i].model);
+            }
+            g_camera.get_frustum().cull(bounds, nb_lights, visible);
+            light_item.nb_instances = compact_visible(light_instances, visible, nb_lights);
+            if (light_item.nb_instances) {
+                std::memcpy(instance_data + lights_off, light_instances, light_item.nb_instances * sizeof(LightInstance));
+                g_render_queue.submit(light_item);
+            }
         }
 
-        light_vao.bind();
-        light_program.bind();
-        light_program.set_value("u_view_proj", g_camera.get_view_proj());
-        for (std::size_t i = 0; i < 5; ++i) {
-            light_program.set_value("u_light_col", pt_light_params[i].color);
-            light_program.set_value("u_model",
-                glm::scale(glm::translate(glm::mat4(1.0f), array_pos[i]), glm::vec3(0.3f)));
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+        {
+            PROFILE_ZONE("Render queue");
+            std::size_t instance_off = instance_stream.end();
+            vao.set_vertex_buffer({{BufferElement::Mat4}, 1}, instance_stream, nb_attribs, instance_off);
+            vao.set_vertex_buffer({{BufferElement::Mat3}, 1}, instance_stream, nb_cube_attribs, instance_off + cube_normals_off);
+            light_vao.set_vertex_buffer({{BufferElement::Mat4, BufferElement::Float3}, 1}, instance_stream, nb_attribs, instance_off + lights_off);
+            g_render_queue.flush();
+            instance_stream.fence();
         }
 
-        g_window->update();
+        {
+            PROFILE_ZONE("Present");
+            g_window->update();
+        }
+        Profiler::end_frame();
+        bench.end_frame();
     }
 
+    bench.report("2-lighting");
+    Profiler::write_trace();
+
     glfwTerminate();
     return 0;
 }
@@ -0,0 +1,19 @@
+#version 330 core
+
+layout (location = 0) in vec3 in_position;
+layout (location = 1) in vec3 in_normal;
+layout (location = 2) in vec2 in_tex_coords;
+layout (location = 3) in mat4 in_model;
+layout (location = 7) in mat3 in_normal_mat;
+
+out vec3 normal, frag_pos;
+out vec2 tex_coords;
+
+uniform mat4 u_view_proj;
+
+void main() {
+    normal = in_normal_mat * in_normal;
+    frag_pos = vec3(in_model * vec4(in_position, 1.0f));
+    tex_coords = in_tex_coords;
+    gl_Position = u_view_proj * vec4(frag_pos, 1.0f);
+}
@@ -0,0 +1,9 @@
+#version 330 core
+
+in vec3 light_col;
+
+out vec4 out_color;
+
+void main() {
+    out_color = vec4(light_col, 1.0f);
+}
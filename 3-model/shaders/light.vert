@@ -0,0 +1,14 @@
+#version 330 core
+
+layout (location = 0) in vec3 in_position;
+layout (location = 3) in mat4 in_model;
+layout (location = 7) in vec3 in_color;
+
+out vec3 light_col;
+
+uniform mat4 u_view_proj;
+
+void main() {
+    light_col   = in_color;
+    gl_Position = u_view_proj * in_model * vec4(in_position, 1.0f);
+}
@@ -0,0 +1,24 @@
+#version 330 core
+
+// Positions of packed meshes are normalized to the mesh bounds, and brought back with u_pos_offset/u_pos_scale
+// (0 and 1 for float meshes); packed normals and texture coordinates are expanded by the vertex fetch
+layout (location = 0) in vec3 in_position;
+layout (location = 1) in vec3 in_normal;
+layout (location = 2) in vec2 in_tex_coords;
+
+out vec3 normal, frag_pos;
+out vec2 tex_coords;
+
+uniform mat4 u_model;
+uniform mat3 u_normal_mat;
+uniform mat4 u_view_proj;
+uniform vec3 u_pos_offset = vec3(0.0f);
+uniform vec3 u_pos_scale  = vec3(1.0f);
+
+void main() {
+    vec3 position = u_pos_offset + in_position * u_pos_scale;
+    normal = u_normal_mat * normalize(in_normal);
+    frag_pos = vec3(u_model * vec4(position, 1.0f));
+    tex_coords = in_tex_coords;
+    gl_Position = u_view_proj * vec4(frag_pos, 1.0f);
+}
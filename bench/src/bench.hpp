@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdio>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+
+#include "utils.hpp"
+
+struct Benchmark {
+    using Fn = int (*)(int argc, char **argv);
+
+    const char *name, *desc;
+    Fn fn;
+
+    static std::vector<Benchmark> &get_registry() {
+        static std::vector<Benchmark> registry;
+        return registry;
+    }
+
+    static const Benchmark *find(const std::string &name) {
+        auto &reg = get_registry();
+        auto it = std::find_if(reg.begin(), reg.end(), [&name](const Benchmark &b) { return name == b.name; });
+        return (it != reg.end()) ? &*it : nullptr;
+    }
+};
+
+struct BenchmarkRegistrar {
+    BenchmarkRegistrar(const char *name, const char *desc, Benchmark::Fn fn) {
+        Benchmark::get_registry().push_back({name, desc, fn});
+    }
+};
+
+#define REGISTER_BENCHMARK(name, desc, fn) \
+    static BenchmarkRegistrar CONCATENATE(_bench_registrar_, __LINE__){name, desc, fn}
+
+class Timer {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        Timer(): start(Clock::now()) { }
+
+        inline void   reset()            { this->start = Clock::now(); }
+        inline double get_ms()     const { return std::chrono::duration<double, std::milli>(Clock::now() - this->start).count(); }
+        inline double get_ns()     const { return std::chrono::duration<double, std::nano>(Clock::now() - this->start).count(); }
+
+    protected:
+        Clock::time_point start;
+};
+
+// Resident set size of the process in bytes, 0 if it can't be read
+inline std::size_t get_rss() {
+    std::size_t size, resident;
+    FILE *fp = std::fopen("/proc/self/statm", "r");
+    if (!fp)
+        return 0;
+    int rc = std::fscanf(fp, "%zu %zu", &size, &resident);
+    std::fclose(fp);
+    return (rc == 2) ? resident * sysconf(_SC_PAGESIZE) : 0;
+}
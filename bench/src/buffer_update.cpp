@@ -0,0 +1,95 @@
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <glad/glad.h>
+
+#include "shader.hpp"
+#include "shader_program.hpp"
+#include "vertex_array.hpp"
+#include "buffer.hpp"
+#include "bench.hpp"
+
+static constexpr const char *vert_src = R"(
+#version 330 core
+layout (location = 0) in vec4 in_value;
+void main() {
+    gl_Position = in_value;
+}
+)";
+
+static constexpr const char *frag_src = R"(
+#version 330 core
+out vec4 out_color;
+void main() {
+    out_color = vec4(1.0f);
+}
+)";
+
+// Each update is followed by a draw sourcing the buffer, so the range is still in use when the next update comes
+// The unsynchronized results are only meaningful when the caller guarantees that (eg. with fences, see StreamBuffer):
+// here the GPU may read data that is being overwritten
+static int bench_buffer_update(int argc, char **argv) {
+    std::size_t total = (argc > 1) ? std::max(std::atol(argv[1]), 1l) << 20 : 256 << 20;
+
+    VertexShader vert_sh;
+    FragmentShader frag_sh;
+    vert_sh.set_source(vert_src);
+    frag_sh.set_source(frag_src);
+    ShaderProgram program{vert_sh, frag_sh};
+    program.use();
+    glEnable(GL_RASTERIZER_DISCARD);
+
+    constexpr std::size_t sizes[] = { 256, 4 << 10, 64 << 10, 1 << 20, 16 << 20 };
+    std::vector<std::uint8_t> data(sizes[SIZEOF_ARRAY(sizes) - 1], 0x3f);
+
+    struct Strategy {
+        const char *name;
+        BufferUpdate update;
+    };
+    constexpr Strategy strategies[] = {
+        { "SubData",           BufferUpdate::SubData           },
+        { "MapUnsynchronized", BufferUpdate::MapUnsynchronized },
+        { "Orphan",            BufferUpdate::Orphan            },
+    };
+
+    std::printf("Renderer: %s\n", (const char *)glGetString(GL_RENDERER));
+    std::printf("Update of a whole buffer, then a draw reading it, %zu MiB per size (us/update, GB/s):\n", total >> 20);
+    std::printf("  %10s", "size");
+    for (auto &strategy: strategies)
+        std::printf(" %26s", strategy.name);
+    std::printf("\n");
+
+    for (std::size_t size: sizes) {
+        std::size_t iterations = std::clamp(total / size, (std::size_t)16, (std::size_t)100000);
+        std::printf("  %10zu", size);
+        for (auto &strategy: strategies) {
+            VertexArray vao;
+            VertexBuffer vbo;
+            vbo.set_data(nullptr, size, GL_STREAM_DRAW);
+            vao.set_layout({ BufferElement::Float4 }, vbo);
+            vao.bind();
+            GLsizei nb_points = std::min(size / 16, (std::size_t)1024);
+
+            auto iteration = [&] {
+                vbo.update(data.data(), size, 0, strategy.update);
+                draw_arrays(GL_POINTS, 0, nb_points);
+            };
+
+            iteration();
+            glFinish();
+            Timer timer;
+            for (std::size_t i = 0; i < iterations; ++i)
+                iteration();
+            glFinish();
+            double us = timer.get_ns() / iterations / 1e3;
+            std::printf(" %14.2f %11.2f", us, size / us / 1e3);
+        }
+        std::printf("\n");
+    }
+
+    glDisable(GL_RASTERIZER_DISCARD);
+    return 0;
+}
+
+REGISTER_BENCHMARK("buffer-update", "cost of rewriting a buffer in use by the GPU, per update strategy and size", bench_buffer_update);
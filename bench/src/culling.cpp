@@ -0,0 +1,66 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "aabb.hpp"
+#include "frustum.hpp"
+#include "bvh.hpp"
+#include "bench.hpp"
+#include "scene.hpp"
+
+template <typename F>
+static double measure_ns(std::size_t iterations, F &&fn) {
+    fn();
+    Timer timer;
+    for (std::size_t i = 0; i < iterations; ++i)
+        fn();
+    return timer.get_ns() / iterations;
+}
+
+// The grid of cubes is spread over [-50, 50]^3 and looked at from its edge, so only a part of it is visible
+static int bench_culling(int argc, char **argv) {
+    std::size_t nb_boxes   = (argc > 1) ? std::max(std::atol(argv[1]), 1l) : 100000;
+    std::size_t iterations = (argc > 2) ? std::max(std::atol(argv[2]), 1l) : 50;
+
+    auto models = make_grid_models(nb_boxes);
+    Aabb unit_box(glm::vec3(-0.5f), glm::vec3(0.5f));
+    glm::mat4 spread = glm::scale(glm::mat4(1.0f), glm::vec3(50.0f));
+    std::vector<Aabb> boxes(nb_boxes);
+    for (std::size_t i = 0; i < nb_boxes; ++i)
+        boxes[i] = unit_box.transform(spread * models[i]);
+
+    Frustum frustum(glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 60.0f)
+        * glm::lookAt(glm::vec3(0.0f, 0.0f, 55.0f), glm::vec3(20.0f, 10.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+    Timer build_timer;
+    Bvh bvh(boxes.data(), boxes.size());
+    double build_ms = build_timer.get_ms();
+
+    std::vector<std::uint8_t> visible(nb_boxes);
+    std::size_t nb_linear = 0, nb_bvh = 0;
+    double linear_ns = measure_ns(iterations, [&] {
+        nb_linear = frustum.cull(boxes.data(), boxes.size(), visible.data());
+    });
+    double bvh_ns = measure_ns(iterations, [&] {
+        nb_bvh = bvh.cull(frustum, [&visible](std::uint32_t prim) { visible[prim] = 1; });
+    });
+
+    std::size_t nb_hits = 0;
+    double ray_ns = measure_ns(iterations, [&] {
+        Bvh::Hit hit;
+        for (int i = 0; i < 64; ++i)
+            nb_hits += bvh.raycast(glm::vec3(0.0f, 0.0f, 55.0f), glm::vec3(0.01f * i - 0.32f, 0.005f * i, -1.0f), hit);
+    }) / 64;
+
+    std::printf("%zu boxes, BVH of %zu nodes built in %.2f ms\n", nb_boxes, bvh.get_nodes().size(), build_ms);
+    std::printf("  %-24s %12.1f us/frame %10zu visible\n", "linear (SIMD)", linear_ns / 1e3, nb_linear);
+    std::printf("  %-24s %12.1f us/frame %10zu visible\n", "BVH",           bvh_ns    / 1e3, nb_bvh);
+    std::printf("  %-24s %12.1f ns/ray\n",                 "BVH raycast",   ray_ns);
+    return 0;
+}
+
+REGISTER_BENCHMARK("culling", "frustum culling of N boxes, linear SIMD test vs BVH traversal", bench_culling);
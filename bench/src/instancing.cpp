@@ -0,0 +1,119 @@
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.hpp"
+#include "shader_program.hpp"
+#include "vertex_array.hpp"
+#include "buffer.hpp"
+#include "bench.hpp"
+#include "scene.hpp"
+
+static constexpr const char *single_vert_src = R"(
+#version 330 core
+layout (location = 0) in vec3 in_position;
+uniform mat4 u_view_proj, u_model;
+void main() {
+    gl_Position = u_view_proj * u_model * vec4(in_position, 1.0f);
+}
+)";
+
+static constexpr const char *instanced_vert_src = R"(
+#version 330 core
+layout (location = 0) in vec3 in_position;
+layout (location = 1) in mat4 in_model;
+uniform mat4 u_view_proj;
+void main() {
+    gl_Position = u_view_proj * in_model * vec4(in_position, 1.0f);
+}
+)";
+
+static constexpr const char *frag_src = R"(
+#version 330 core
+out vec4 out_color;
+void main() {
+    out_color = vec4(gl_FragCoord.zzz, 1.0f);
+}
+)";
+
+// Issuing one draw per cube gets very slow past this point, especially on software rasterizers
+static constexpr std::size_t max_nb_single_draws = 100000;
+
+template <typename F>
+static double measure_frame_ms(std::size_t nb_frames, F &&draw) {
+    auto frame = [&draw] {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        draw();
+        glFinish();
+    };
+
+    frame();
+    Timer timer;
+    for (std::size_t i = 0; i < nb_frames; ++i)
+        frame();
+    return timer.get_ms() / nb_frames;
+}
+
+static int bench_instancing(int argc, char **argv) {
+    std::size_t nb_frames = (argc > 1) ? std::max(std::atol(argv[1]), 1l) : 10;
+    std::size_t max_n     = (argc > 2) ? std::max(std::atol(argv[2]), 1l) : 1000000;
+
+    VertexShader single_sh, instanced_sh;
+    FragmentShader frag_sh;
+    single_sh.set_source(single_vert_src);
+    instanced_sh.set_source(instanced_vert_src);
+    frag_sh.set_source(frag_src);
+    ShaderProgram single_program{single_sh, frag_sh}, instanced_program{instanced_sh, frag_sh};
+
+    auto cube = make_cube();
+    VertexArray vao;
+    VertexBuffer vbo;
+    vbo.set_data(cube.data(), cube.size() * sizeof(glm::vec3));
+    GLuint nb_attribs = vao.set_layout({BufferElement::Float3}, vbo);
+    VertexBuffer instance_vbo;
+    vao.set_layout({{BufferElement::Mat4}, 1}, instance_vbo, nb_attribs);
+    vao.bind();
+
+    glm::mat4 view_proj = get_grid_view_proj();
+    glEnable(GL_DEPTH_TEST);
+
+    std::printf("Renderer: %s\n", (const char *)glGetString(GL_RENDERER));
+    std::printf("Frame time over %zu frames (ms/frame):\n", nb_frames);
+    std::printf("  %10s %14s %14s %10s\n", "cubes", "one draw each", "instanced", "speedup");
+    for (std::size_t n = 10; n <= max_n; n *= 10) {
+        auto models = make_grid_models(n);
+
+        double single_ms = -1.0;
+        if (n <= max_nb_single_draws) {
+            single_program.use();
+            single_program.set_value("u_view_proj", view_proj);
+            GLint model_loc = single_program.get_uniform_loc("u_model");
+            single_ms = measure_frame_ms(nb_frames, [&] {
+                for (auto &model: models) {
+                    single_program.set_value(model_loc, model);
+                    glDrawArrays(GL_TRIANGLES, 0, cube.size());
+                }
+            });
+        }
+
+        instanced_program.use();
+        instanced_program.set_value("u_view_proj", view_proj);
+        instance_vbo.bind();
+        instance_vbo.set_data(nullptr, n * sizeof(glm::mat4), GL_STREAM_DRAW);
+        double instanced_ms = measure_frame_ms(nb_frames, [&] {
+            instance_vbo.set_sub_data(models.data(), n * sizeof(glm::mat4));
+            glDrawArraysInstanced(GL_TRIANGLES, 0, cube.size(), n);
+        });
+
+        if (single_ms >= 0.0)
+            std::printf("  %10zu %14.3f %14.3f %9.1fx\n", n, single_ms, instanced_ms, single_ms / instanced_ms);
+        else
+            std::printf("  %10zu %14s %14.3f %10s\n", n, "-", instanced_ms, "-");
+    }
+    return 0;
+}
+
+REGISTER_BENCHMARK("instancing", "frame time of N cubes drawn one by one vs in one instanced call", bench_instancing);
@@ -0,0 +1,43 @@
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "window.hpp"
+#include "mesh.hpp"
+#include "bench.hpp"
+
+static void print_usage(const char *argv0) {
+    std::printf("Usage: %s <benchmark> [args...]\nAvailable benchmarks:\n", argv0);
+    for (auto &bench: Benchmark::get_registry())
+        std::printf("  %-16s %s\n", bench.name, bench.desc);
+}
+
+int main(int argc, char **argv) {
+    const Benchmark *bench;
+    if ((argc < 2) || !(bench = Benchmark::find(argv[1]))) {
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    glfwInit();
+    Window::hint(std::pair{GLFW_VISIBLE, GLFW_FALSE});
+    Window window(800, 800, "bench");
+    window.set_vsync(false);
+
+    if (!window.load_gl()) {
+        std::cout << "Failed to initialize GLEW" << std::endl;
+        return -1;
+    }
+
+    int rc;
+    {
+        // Torn down while the context is still alive
+        Mesh::Arenas mesh_arenas;
+        rc = bench->fn(argc - 1, argv + 1);
+    }
+
+    glfwTerminate();
+    return rc;
+}
@@ -0,0 +1,73 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "model.hpp"
+#include "mesh_cache.hpp"
+#include "mesh_optimizer.hpp"
+#include "bench.hpp"
+
+static void print_stats(const char *name, std::size_t nb_triangles, const MeshOptimizer::Stats &stats) {
+    std::printf("  %-24s %8zu tris   ACMR %5.3f -> %5.3f   ATVR %5.3f -> %5.3f\n", name, nb_triangles,
+        stats.before.acmr, stats.after.acmr, stats.before.atvr, stats.after.atvr);
+}
+
+// Without a model, optimizes a grid whose triangles were shuffled (the worst case for the cache)
+static int bench_mesh_optimize(int argc, char **argv) {
+    if ((argc > 1) && std::string(argv[1]) != "grid") {
+        std::string path = argv[1];
+        MeshCache::remove(path, Model::default_import_flags, Model::OptimizeMeshes);
+
+        Timer timer;
+        Model model{path, Model::default_import_flags, nullptr, Model::OptimizeMeshes};
+        double load_ms = timer.get_ms();
+
+        auto &stats = model.get_optimize_stats();
+        std::printf("%s: %zu meshes, loaded and optimized in %.2fms\n", path.c_str(), stats.size(), load_ms);
+        for (std::size_t i = 0; i < stats.size(); ++i) {
+            std::string name = "mesh " + std::to_string(i);
+            print_stats(name.c_str(), model.get_meshes()[i].get_nb_indices() / 3, stats[i]);
+        }
+        return 0;
+    }
+
+    std::size_t size = (argc > 2) ? std::max(std::atol(argv[2]), 2l) : 256;
+
+    std::vector<Mesh::Vertex> vertices(size * size);
+    for (std::size_t y = 0; y < size; ++y)
+        for (std::size_t x = 0; x < size; ++x)
+            vertices[y * size + x] = { glm::vec3(x, 0.0f, y), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(x, y) / (float)size };
+
+    std::vector<GLuint> quads;
+    quads.reserve((size - 1) * (size - 1) * 6);
+    for (std::size_t y = 0; y < size - 1; ++y) {
+        for (std::size_t x = 0; x < size - 1; ++x) {
+            GLuint i = y * size + x;
+            quads.insert(quads.end(), { i, i + (GLuint)size, i + 1, i + 1, i + (GLuint)size, i + (GLuint)size + 1 });
+        }
+    }
+
+    std::vector<std::size_t> order(quads.size() / 3);
+    for (std::size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937{42});
+    std::vector<GLuint> indices;
+    indices.reserve(quads.size());
+    for (std::size_t t: order)
+        indices.insert(indices.end(), quads.begin() + 3 * t, quads.begin() + 3 * t + 3);
+
+    Timer timer;
+    auto stats = MeshOptimizer::optimize(vertices, indices);
+    double ms = timer.get_ms();
+
+    std::printf("%zux%zu shuffled grid, optimized in %.2fms\n", size, size, ms);
+    print_stats("grid", indices.size() / 3, stats);
+    return 0;
+}
+
+REGISTER_BENCHMARK("mesh-optimize", "Vertex cache statistics before/after MeshOptimizer, on a model or a shuffled grid", bench_mesh_optimize);
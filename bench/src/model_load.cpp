@@ -0,0 +1,91 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <glad/glad.h>
+
+#include "shader_program.hpp"
+#include "model.hpp"
+#include "mesh_cache.hpp"
+#include "thread_pool.hpp"
+#include "texture_cache.hpp"
+#include "bench.hpp"
+
+// Cold load goes through Assimp and (re)writes the mesh cache, warm load maps the cache back
+// With a thread count, cold loads extract meshes on a pool of that size
+// "packed" uploads the meshes with the compact vertex layout
+static int bench_model_load(int argc, char **argv) {
+    if (argc < 2) {
+        std::printf("Usage: model-load <model path> [iterations] [threads] [packed]\n");
+        return -1;
+    }
+
+    std::string path = argv[1];
+    int iterations = (argc > 2) ? std::max(std::atoi(argv[2]), 1) : 5;
+    int nb_threads = (argc > 3) ? std::max(std::atoi(argv[3]), 0) : 0;
+    std::uint32_t options = ((argc > 4) && (std::string(argv[4]) == "packed")) ? Model::PackVertices : 0;
+
+    // Warm loads are served by the cache, on unless LOGL_MESH_CACHE disables it
+    MeshCache::set_default_directory(".cache");
+
+    std::unique_ptr<ThreadPool> pool;
+    if (nb_threads)
+        pool = std::make_unique<ThreadPool>(nb_threads);
+
+    double cold_min = 1e30, cold_sum = 0, warm_min = 1e30, warm_sum = 0;
+    std::size_t nb_meshes = 0, nb_short = 0, gpu_size = 0;
+    for (int i = 0; i < iterations; ++i) {
+        MeshCache::remove(path, Model::default_import_flags);
+
+        Timer timer;
+        {
+            Model model{path, Model::default_import_flags, pool.get(), options};
+            glFinish();
+            nb_meshes = model.get_meshes().size(), nb_short = gpu_size = 0;
+            for (auto &mesh: model.get_meshes())
+                nb_short += mesh.get_index_type() == GL_UNSIGNED_SHORT, gpu_size += mesh.get_gpu_size();
+        }
+        double cold = timer.get_ms();
+
+        timer.reset();
+        {
+            Model model{path, Model::default_import_flags, nullptr, options};
+            glFinish();
+        }
+        double warm = timer.get_ms();
+
+        cold_min = std::min(cold_min, cold), cold_sum += cold;
+        warm_min = std::min(warm_min, warm), warm_sum += warm;
+    }
+
+    std::printf("%s: %zu meshes, %d iterations, %d extraction threads\n", path.c_str(), nb_meshes, iterations, nb_threads);
+    std::printf("  cold: min %8.3fms, avg %8.3fms\n", cold_min, cold_sum / iterations);
+    std::printf("  warm: min %8.3fms, avg %8.3fms\n", warm_min, warm_sum / iterations);
+    std::printf("  speedup: %.2fx\n", cold_min / warm_min);
+    std::printf("  geometry: %.1fKiB, %zu/%zu meshes with 16-bit indices\n", gpu_size / 1024.0, nb_short, nb_meshes);
+
+    auto &arena = Mesh::get_arena((options & Model::PackVertices) ? Mesh::VertexFormat::Packed : Mesh::VertexFormat::Float);
+    std::printf("  arena: %.1f/%.1fKiB vertices, %.1f/%.1fKiB indices, in 1 VAO and 2 buffers\n",
+        arena.get_vertex_alloc().get_used() / 1024.0, arena.get_vertex_alloc().get_capacity() / 1024.0,
+        arena.get_index_alloc().get_used()  / 1024.0, arena.get_index_alloc().get_capacity()  / 1024.0);
+
+    // Memory held while a model is alive, with and without the CPU copy of its geometry
+    // Warm loads, so the importer's own allocations don't get in the way
+    auto get_held_rss = [&](std::uint32_t opts) {
+        std::size_t before = get_rss();
+        Model model{path, Model::default_import_flags, nullptr, options | opts};
+        glFinish();
+        return (double)get_rss() - before;
+    };
+    double gpu_only_rss = get_held_rss(0), cpu_copy_rss = get_held_rss(Model::KeepGeometry);
+    std::printf("  RSS held: %.1fKiB GPU only, %.1fKiB with CPU copies (%.1fKiB saved)\n",
+        gpu_only_rss / 1024.0, cpu_copy_rss / 1024.0, (cpu_copy_rss - gpu_only_rss) / 1024.0);
+
+    auto &tex_stats = TextureCache::get_stats();
+    std::printf("  texture cache: %zu hits, %zu misses\n", tex_stats.hits, tex_stats.misses);
+    return 0;
+}
+
+REGISTER_BENCHMARK("model-load", "Cold (Assimp) vs warm (mesh cache) Model::load times", bench_model_load);
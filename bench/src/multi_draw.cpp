@@ -0,0 +1,109 @@
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.hpp"
+#include "shader_program.hpp"
+#include "mesh.hpp"
+#include "multi_draw.hpp"
+#include "bench.hpp"
+#include "scene.hpp"
+
+static constexpr const char *vert_src = R"(
+#version 330 core
+layout (location = 0) in vec3 in_position;
+uniform mat4 u_view_proj;
+void main() {
+    gl_Position = u_view_proj * vec4(in_position, 1.0f);
+}
+)";
+
+static constexpr const char *frag_src = R"(
+#version 330 core
+out vec4 out_color;
+void main() {
+    out_color = vec4(gl_FragCoord.zzz, 1.0f);
+}
+)";
+
+template <typename F>
+static double measure_frame_ms(std::size_t nb_frames, F &&draw) {
+    auto frame = [&draw] {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        draw();
+        glFinish();
+    };
+
+    frame();
+    Timer timer;
+    for (std::size_t i = 0; i < nb_frames; ++i)
+        frame();
+    return timer.get_ms() / nb_frames;
+}
+
+// Every cube is its own mesh in the shared arena, with its transform baked into the vertices,
+// so the only per-mesh work left is the draw submission itself
+static int bench_multi_draw(int argc, char **argv) {
+    std::size_t nb_meshes = (argc > 1) ? std::max(std::atol(argv[1]), 1l) : 10000;
+    std::size_t nb_frames = (argc > 2) ? std::max(std::atol(argv[2]), 1l) : 20;
+
+    VertexShader vert_sh;
+    FragmentShader frag_sh;
+    vert_sh.set_source(vert_src);
+    frag_sh.set_source(frag_src);
+    ShaderProgram program{vert_sh, frag_sh};
+    program.use();
+    program.set_value("u_view_proj", get_grid_view_proj());
+
+    auto cube   = make_cube();
+    auto models = make_grid_models(nb_meshes);
+    std::vector<Mesh::Texture> textures;
+    std::vector<Mesh> meshes;
+    meshes.reserve(nb_meshes);
+    for (auto &model: models) {
+        std::vector<Mesh::Vertex> vertices;
+        std::vector<GLuint> indices;
+        for (auto &pos: cube) {
+            indices.push_back(vertices.size());
+            vertices.push_back({ glm::vec3(model * glm::vec4(pos, 1.0f)), glm::vec3(0.0f), glm::vec2(0.0f) });
+        }
+        meshes.emplace_back(vertices, indices, textures);
+    }
+
+    glEnable(GL_DEPTH_TEST);
+
+    double single_ms = measure_frame_ms(nb_frames, [&] {
+        for (auto &mesh: meshes)
+            mesh.draw(program);
+    });
+
+    auto measure_batch = [&](bool allow_indirect) {
+        MultiDrawBatch batch(allow_indirect);
+        return measure_frame_ms(nb_frames, [&] {
+            batch.clear();
+            for (auto &mesh: meshes)
+                mesh.add_to(batch);
+            Mesh::get_arena(Mesh::VertexFormat::Float).bind();
+            batch.submit(GL_TRIANGLES, meshes.front().get_index_type());
+        });
+    };
+    double base_vertex_ms = measure_batch(false), indirect_ms = measure_batch(true);
+
+    auto print = [nb_meshes](const char *name, double ms) {
+        std::printf("  %-36s %10.3f ms/frame %12.0f draws/s\n", name, ms, nb_meshes / ms * 1e3);
+    };
+    std::printf("Renderer: %s\n", (const char *)glGetString(GL_RENDERER));
+    std::printf("%zu meshes over %zu frames:\n", nb_meshes, nb_frames);
+    print("Mesh::draw each", single_ms);
+    print("glMultiDrawElementsBaseVertex", base_vertex_ms);
+    if (MultiDrawBatch::is_indirect_supported())
+        print("glMultiDrawElementsIndirect", indirect_ms);
+    else
+        std::printf("  %-36s unsupported\n", "glMultiDrawElementsIndirect");
+    return 0;
+}
+
+REGISTER_BENCHMARK("multi-draw", "draw submission rate of N meshes, one call each vs multi-draw (indirect)", bench_multi_draw);
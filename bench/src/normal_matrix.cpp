@@ -0,0 +1,137 @@
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.hpp"
+#include "shader_program.hpp"
+#include "vertex_array.hpp"
+#include "buffer.hpp"
+#include "normal_matrix.hpp"
+#include "bench.hpp"
+#include "scene.hpp"
+
+// Both variants use the cube position as its normal, which is all the benchmark needs
+static constexpr const char *inverse_vert_src = R"(
+#version 330 core
+layout (location = 0) in vec3 in_position;
+layout (location = 1) in mat4 in_model;
+out vec3 normal;
+uniform mat4 u_view_proj;
+void main() {
+    normal      = mat3(transpose(inverse(in_model))) * in_position;
+    gl_Position = u_view_proj * in_model * vec4(in_position, 1.0f);
+}
+)";
+
+static constexpr const char *attrib_vert_src = R"(
+#version 330 core
+layout (location = 0) in vec3 in_position;
+layout (location = 1) in mat4 in_model;
+layout (location = 5) in mat3 in_normal_mat;
+out vec3 normal;
+uniform mat4 u_view_proj;
+void main() {
+    normal      = in_normal_mat * in_position;
+    gl_Position = u_view_proj * in_model * vec4(in_position, 1.0f);
+}
+)";
+
+static constexpr const char *frag_src = R"(
+#version 330 core
+in vec3 normal;
+out vec4 out_color;
+void main() {
+    out_color = vec4(normalize(normal), 1.0f);
+}
+)";
+
+template <typename F>
+static double measure_ms(std::size_t iterations, F &&fn) {
+    fn();
+    glFinish();
+    Timer timer;
+    for (std::size_t i = 0; i < iterations; ++i)
+        fn();
+    glFinish();
+    return timer.get_ms() / iterations;
+}
+
+static int bench_normal_matrix(int argc, char **argv) {
+    std::size_t nb_cubes  = (argc > 1) ? std::max(std::atol(argv[1]), 1l) : 100000;
+    std::size_t nb_frames = (argc > 2) ? std::max(std::atol(argv[2]), 1l) : 20;
+
+    auto models = make_grid_models(nb_cubes);
+    std::vector<glm::mat3> normals(nb_cubes);
+
+    std::printf("CPU normal matrices for %zu objects (ns/matrix):\n", nb_cubes);
+    std::printf("  %-36s %8.2f\n", "glm transpose(inverse(mat3))", 1e6 / nb_cubes * measure_ms(nb_frames, [&] {
+        for (std::size_t i = 0; i < nb_cubes; ++i)
+            normals[i] = glm::transpose(glm::inverse(glm::mat3(models[i])));
+    }));
+    std::printf("  %-36s %8.2f\n", "get_normal_matrix", 1e6 / nb_cubes * measure_ms(nb_frames, [&] {
+        for (std::size_t i = 0; i < nb_cubes; ++i)
+            normals[i] = get_normal_matrix(models[i]);
+    }));
+    std::printf("  %-36s %8.2f\n", "compute_normal_matrices (batch)", 1e6 / nb_cubes * measure_ms(nb_frames, [&] {
+        compute_normal_matrices(models.data(), normals.data(), nb_cubes);
+    }));
+
+    VertexShader inverse_sh, attrib_sh;
+    FragmentShader frag_sh;
+    inverse_sh.set_source(inverse_vert_src);
+    attrib_sh.set_source(attrib_vert_src);
+    frag_sh.set_source(frag_src);
+    ShaderProgram inverse_program{inverse_sh, frag_sh}, attrib_program{attrib_sh, frag_sh};
+
+    auto cube = make_cube();
+    VertexArray vao;
+    VertexBuffer vbo;
+    vbo.set_data(cube.data(), cube.size() * sizeof(glm::vec3));
+    GLuint nb_attribs = vao.set_layout({BufferElement::Float3}, vbo);
+    VertexBuffer model_vbo;
+    model_vbo.set_data(nullptr, nb_cubes * sizeof(glm::mat4), GL_STREAM_DRAW);
+    nb_attribs = vao.set_layout({{BufferElement::Mat4}, 1}, model_vbo, nb_attribs);
+    VertexBuffer normal_vbo;
+    normal_vbo.set_data(nullptr, nb_cubes * sizeof(glm::mat3), GL_STREAM_DRAW);
+    vao.set_layout({{BufferElement::Mat3}, 1}, normal_vbo, nb_attribs);
+    vao.bind();
+
+    // Rasterization is skipped so only vertex processing is measured
+    glEnable(GL_RASTERIZER_DISCARD);
+
+    glm::mat4 view_proj = get_grid_view_proj();
+    double nb_verts = (double)nb_cubes * cube.size();
+    auto print = [nb_verts](const char *name, double ms) {
+        std::printf("  %-36s %8.3f ms %10.2f Mvert/s\n", name, ms, nb_verts / ms / 1e3);
+    };
+
+    std::printf("Vertex throughput, %zu cubes over %zu frames (%s):\n",
+        nb_cubes, nb_frames, (const char *)glGetString(GL_RENDERER));
+
+    inverse_program.use();
+    inverse_program.set_value("u_view_proj", view_proj);
+    print("inverse() per vertex", measure_ms(nb_frames, [&] {
+        model_vbo.bind();
+        model_vbo.set_sub_data(models.data(), nb_cubes * sizeof(glm::mat4));
+        glDrawArraysInstanced(GL_TRIANGLES, 0, cube.size(), nb_cubes);
+    }));
+
+    attrib_program.use();
+    attrib_program.set_value("u_view_proj", view_proj);
+    print("CPU normal matrix attribute", measure_ms(nb_frames, [&] {
+        compute_normal_matrices(models.data(), normals.data(), nb_cubes);
+        model_vbo.bind();
+        model_vbo.set_sub_data(models.data(), nb_cubes * sizeof(glm::mat4));
+        normal_vbo.bind();
+        normal_vbo.set_sub_data(normals.data(), nb_cubes * sizeof(glm::mat3));
+        glDrawArraysInstanced(GL_TRIANGLES, 0, cube.size(), nb_cubes);
+    }));
+
+    glDisable(GL_RASTERIZER_DISCARD);
+    return 0;
+}
+
+REGISTER_BENCHMARK("normal-matrix", "normal matrices from inverse() in the vertex shader vs computed on the CPU", bench_normal_matrix);
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// Unit cube centered on the origin, as 36 unindexed vertices
+inline std::vector<glm::vec3> make_cube() {
+    static constexpr int indices[] = {
+        0, 2, 6, 0, 6, 4,   1, 5, 7, 1, 7, 3,
+        0, 4, 5, 0, 5, 1,   2, 3, 7, 2, 7, 6,
+        0, 1, 3, 0, 3, 2,   4, 6, 7, 4, 7, 5,
+    };
+    std::vector<glm::vec3> vertices;
+    for (int i: indices)
+        vertices.emplace_back((i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f);
+    return vertices;
+}
+
+// Packs n cubes in a grid filling [-1, 1]^3, each rotated by its index
+inline std::vector<glm::mat4> make_grid_models(std::size_t n) {
+    std::size_t side = std::max((std::size_t)std::ceil(std::cbrt((double)n)), (std::size_t)1);
+    float scale = 2.0f / side;
+    std::vector<glm::mat4> models(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        glm::vec3 cell(i % side, (i / side) % side, i / (side * side));
+        glm::vec3 pos = (cell + 0.5f) * scale - 1.0f;
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), pos);
+        model = glm::rotate(model, (float)i, glm::normalize(glm::vec3(1.0f, 0.5f, 0.25f)));
+        models[i] = glm::scale(model, glm::vec3(0.5f * scale));
+    }
+    return models;
+}
+
+inline glm::mat4 get_grid_view_proj() {
+    return glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 10.0f)
+        * glm::lookAt(glm::vec3(0.0f, 0.0f, 3.5f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+}
@@ -0,0 +1,112 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <map>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.hpp"
+#include "shader_program.hpp"
+#include "bench.hpp"
+
+static constexpr const char *vert_src = R"(
+#version 330 core
+void main() {
+    gl_Position = vec4(0.0f);
+}
+)";
+
+static constexpr const char *frag_src = R"(
+#version 330 core
+struct light_t {
+    vec3 position, color;
+};
+out vec4 out_color;
+uniform vec3    u_color;
+uniform light_t u_lights[8];
+void main() {
+    vec3 color = u_color;
+    for (int i = 0; i < u_lights.length(); ++i)
+        color += u_lights[i].position * u_lights[i].color;
+    out_color = vec4(color, 1.0f);
+}
+)";
+
+// Replica of the former lookup: std::map keyed by std::string, filled lazily from glGetUniformLocation
+struct MapLookup {
+    struct Comp {
+        bool operator()(const std::string &s1, const std::string &s2) const {
+            return strcmp(s1.c_str(), s2.c_str()) < 0;
+        }
+    };
+
+    GLint get(GLuint program, const std::string &name) {
+        auto it = this->cache.find(name);
+        if (it != this->cache.end())
+            return it->second;
+        return this->cache[name] = glGetUniformLocation(program, name.c_str());
+    }
+
+    std::map<std::string, GLint, Comp> cache;
+};
+
+template <typename F>
+static double measure_ns(std::size_t iterations, F &&fn) {
+    for (std::size_t i = 0; i < iterations / 10; ++i)
+        fn(i);
+    glFinish();
+    Timer timer;
+    for (std::size_t i = 0; i < iterations; ++i)
+        fn(i);
+    glFinish();
+    return timer.get_ns() / iterations;
+}
+
+static int bench_uniforms(int argc, char **argv) {
+    std::size_t iterations = (argc > 1) ? std::max(std::atol(argv[1]), 1l) : 1000000;
+
+    VertexShader vert_sh;
+    FragmentShader frag_sh;
+    vert_sh.set_source(vert_src);
+    frag_sh.set_source(frag_src);
+    ShaderProgram program{vert_sh, frag_sh};
+    program.use();
+
+    MapLookup map;
+    GLint color_loc = glGetUniformLocation(program.get_handle(), "u_color");
+    auto val = [](std::size_t i) { return glm::vec3((float)(i & 0xff)); };
+
+    std::printf("set_value cost over %zu calls (ns/call):\n", iterations);
+    std::printf("  %-40s %8.2f\n", "raw location", measure_ns(iterations, [&](std::size_t i) {
+        program.set_value(color_loc, val(i));
+    }));
+    std::printf("  %-40s %8.2f\n", "std::map, literal name", measure_ns(iterations, [&](std::size_t i) {
+        program.set_value(map.get(program.get_handle(), "u_color"), val(i));
+    }));
+    std::printf("  %-40s %8.2f\n", "std::map, name built per call", measure_ns(iterations, [&](std::size_t i) {
+        program.set_value(map.get(program.get_handle(), "u_lights[" + std::to_string(i & 7) + "].position"), val(i));
+    }));
+    std::printf("  %-40s %8.2f\n", "UniformId, literal name", measure_ns(iterations, [&](std::size_t i) {
+        program.set_value("u_color", val(i));
+    }));
+    std::printf("  %-40s %8.2f\n", "UniformId, precomputed", measure_ns(iterations, [&](std::size_t i) {
+        static constexpr UniformId id = "u_color"_u;
+        program.set_value(id, val(i));
+    }));
+    std::printf("  %-40s %8.2f\n", "UniformId, index appended per call", measure_ns(iterations, [&](std::size_t i) {
+        static constexpr UniformId id = "u_lights"_u;
+        program.set_value(id[i & 7].field("position"), val(i));
+    }));
+
+    ShaderProgram::reset_uniform_stats();
+    std::printf("  %-40s %8.2f\n", "UniformId, unchanged value", measure_ns(iterations, [&](std::size_t i) {
+        static constexpr UniformId id = "u_color"_u;
+        program.set_value(id, glm::vec3(1.0f));
+    }));
+    auto &stats = ShaderProgram::get_uniform_stats();
+    std::printf("  %zu calls issued, %zu elided\n", stats.issued, stats.elided);
+    return 0;
+}
+
+REGISTER_BENCHMARK("uniforms", "ns per ShaderProgram::set_value for each uniform lookup strategy", bench_uniforms);
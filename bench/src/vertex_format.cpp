@@ -0,0 +1,133 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shader.hpp"
+#include "shader_program.hpp"
+#include "texture.hpp"
+#include "lighting.hpp"
+#include "model.hpp"
+#include "bench.hpp"
+
+// The benchmark runs from bench/, next to the demo owning the model shaders
+static constexpr const char *shader_dir = "../3-model/shaders/";
+
+struct FormatResult {
+    double ms;
+    std::size_t gpu_size;
+    std::vector<std::uint8_t> pixels;
+};
+
+// The model is fitted to the view and turned so that its normals go through a non-trivial normal matrix
+static FormatResult render_model(const std::string &path, std::uint32_t options, ShaderProgram &program, std::size_t nb_frames) {
+    Model model{path, Model::default_import_flags, nullptr, options};
+
+    FormatResult res = {};
+    Aabb bounds;
+    for (auto &mesh: model.get_meshes())
+        bounds.extend(mesh.get_bounds()), res.gpu_size += mesh.get_gpu_size();
+    glm::vec3 extent = bounds.get_extent();
+    float scale = 1.0f / std::max({extent.x, extent.y, extent.z, 1e-6f});
+    glm::mat4 model_mat = glm::rotate(glm::mat4(1.0f), glm::radians(30.0f), glm::vec3(0.3f, 1.0f, 0.0f))
+        * glm::scale(glm::mat4(1.0f), glm::vec3(scale)) * glm::translate(glm::mat4(1.0f), -bounds.get_center());
+
+    auto frame = [&] {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        model.draw(program, model_mat);
+        glFinish();
+    };
+
+    frame();
+    Timer timer;
+    for (std::size_t i = 0; i < nb_frames; ++i)
+        frame();
+    res.ms = timer.get_ms() / nb_frames;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    res.pixels.resize(viewport[2] * viewport[3] * 4);
+    glReadPixels(0, 0, viewport[2], viewport[3], GL_RGBA, GL_UNSIGNED_BYTE, res.pixels.data());
+    return res;
+}
+
+// Renders a model uploaded with the float and the packed vertex layouts through 3-model's shaders,
+// and compares the frame time and the images: differences come from the quantized positions and normals
+static int bench_vertex_format(int argc, char **argv) {
+    if (argc < 2) {
+        std::printf("Usage: vertex-format <model path> [frames]\n");
+        return -1;
+    }
+
+    std::string path = argv[1];
+    std::size_t nb_frames = (argc > 2) ? std::max(std::atol(argv[2]), 1l) : 100;
+
+    ShaderProgram program{VertexShader{std::string(shader_dir) + "model.vert"},
+        FragmentShader{std::string(shader_dir) + "model.frag"}};
+    program.bind();
+    program.set_value("u_view_proj", glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 10.0f)
+        * glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+    program.set_value("u_view_pos", glm::vec3(0.0f, 0.0f, 3.0f));
+    program.set_value("material.shininess", 32.0f);
+
+    // A single white directional light, the point lights and the spotlight are left black
+    constexpr GLuint lighting_binding = 0;
+    program.bind_uniform_block(LightingBlock::name, lighting_binding);
+    UniformBuffer<LightingBlock> lighting_ubo{lighting_binding};
+    auto &lighting = lighting_ubo.get();
+    for (auto &pt_light: lighting.pt_lights)
+        pt_light.constant = 1.0f;
+    lighting.dir_light.light.ambient  = glm::vec3(0.1f);
+    lighting.dir_light.light.diffuse  = glm::vec3(0.7f);
+    lighting.dir_light.light.specular = glm::vec3(0.3f);
+    lighting.dir_light.direction      = glm::vec3(-0.2f, -1.0f, -0.3f);
+    lighting.spotlight.inner_cutoff   = 1.0f;
+    lighting.spotlight.outer_cutoff   = 0.0f;
+    lighting_ubo.update();
+
+    // Meshes without textures sample these, Mesh::set_uniforms repoints the samplers of the others
+    program.set_value("material.tex_diff_0", 0);
+    program.set_value("material.tex_spec_0", 1);
+    std::uint8_t white[] = { 0xff, 0xff, 0xff };
+    Texture2d diff_tex, spec_tex;
+    for (auto *tex: { &diff_tex, &spec_tex }) {
+        tex->set_data(white, 1, 1);
+        tex->set_parameters(std::pair{GL_TEXTURE_MIN_FILTER, GL_NEAREST});
+    }
+    diff_tex.bind_unit(0);
+    spec_tex.bind_unit(1);
+
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    FormatResult full = render_model(path, 0, program, nb_frames);
+    diff_tex.bind_unit(0), spec_tex.bind_unit(1);
+    FormatResult packed = render_model(path, Model::PackVertices, program, nb_frames);
+
+    std::size_t nb_pixels = full.pixels.size() / 4, nb_covered = 0, nb_different = 0;
+    int max_diff = 0;
+    double diff_sum = 0;
+    for (std::size_t i = 0; i < nb_pixels; ++i) {
+        int diff = 0;
+        for (std::size_t c = 0; c < 3; ++c)
+            diff = std::max(diff, std::abs(full.pixels[4 * i + c] - packed.pixels[4 * i + c]));
+        bool covered = full.pixels[4 * i] || full.pixels[4 * i + 1] || full.pixels[4 * i + 2];
+        nb_covered += covered, nb_different += diff > 2;
+        max_diff = std::max(max_diff, diff), diff_sum += diff;
+    }
+
+    std::printf("Renderer: %s\n", (const char *)glGetString(GL_RENDERER));
+    std::printf("%s, %zu frames:\n", path.c_str(), nb_frames);
+    std::printf("  %-8s %10.3f ms/frame %10.1fKiB geometry\n", "float",  full.ms,   full.gpu_size   / 1024.0);
+    std::printf("  %-8s %10.3f ms/frame %10.1fKiB geometry\n", "packed", packed.ms, packed.gpu_size / 1024.0);
+    std::printf("  image: %zu/%zu covered pixels differ by more than 2, max %d, mean %.4f over the frame (out of 255)\n",
+        nb_different, nb_covered, max_diff, diff_sum / std::max(nb_pixels, (std::size_t)1));
+    return 0;
+}
+
+REGISTER_BENCHMARK("vertex-format", "frame time and image difference of a model drawn with float vs packed vertices", bench_vertex_format);
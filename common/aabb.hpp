@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <glm/glm.hpp>
+
+#include "utils.hpp"
+
+// Axis-aligned bounding box, empty (min > max) when default-constructed
+struct Aabb {
+    glm::vec3 min = glm::vec3( std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    Aabb() = default;
+    Aabb(const glm::vec3 &min, const glm::vec3 &max): min(min), max(max) { }
+
+    // Vertices are read with a stride, so the position can be picked out of an interleaved vertex
+    static Aabb from_points(const void *points, std::size_t nb_points, std::size_t stride = sizeof(glm::vec3)) {
+        Aabb box;
+        for (std::size_t i = 0; i < nb_points; ++i)
+            box.extend(*(const glm::vec3 *)((const std::uint8_t *)points + i * stride));
+        return box;
+    }
+
+    inline void extend(const glm::vec3 &point) {
+        this->min = glm::min(this->min, point), this->max = glm::max(this->max, point);
+    }
+
+    inline void extend(const Aabb &box) {
+        this->min = glm::min(this->min, box.min), this->max = glm::max(this->max, box.max);
+    }
+
+    inline bool      is_empty()    const { return (this->min.x > this->max.x) || (this->min.y > this->max.y) || (this->min.z > this->max.z); }
+    inline glm::vec3 get_center()  const { return 0.5f * (this->min + this->max); }
+    inline glm::vec3 get_extent()  const { return 0.5f * (this->max - this->min); }
+
+    inline float get_surface_area() const {
+        glm::vec3 d = this->max - this->min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    // Bounds of the transformed box (Arvo): the extent is carried through the absolute value of the linear part
+    Aabb transform(const glm::mat4 &mat) const {
+        glm::vec3 center = glm::vec3(mat * glm::vec4(get_center(), 1.0f)), extent = get_extent();
+        glm::vec3 new_extent = glm::abs(glm::vec3(mat[0])) * extent.x + glm::abs(glm::vec3(mat[1])) * extent.y
+            + glm::abs(glm::vec3(mat[2])) * extent.z;
+        return Aabb(center - new_extent, center + new_extent);
+    }
+};
+ASSERT_SIZE(Aabb, 24);
@@ -1,52 +1,73 @@
 #pragma once
 
 #include <cstdint>
+#include <cstring>
 #include <stdexcept>
+#include <type_traits>
 #include <initializer_list>
 #include <glad/glad.h>
 
 #include "object.hpp"
+#include "gl_state.hpp"
+#include "render_stats.hpp"
 #include "utils.hpp"
 
+// Half, Short and Packed are compact vertex formats (see vertex_packing.hpp), usually read normalized
+// Packed4 is GL_INT_2_10_10_10_REV: 3 10-bit components and a 2-bit one in 4 bytes
 struct BufferElement {
-    enum Type: uint8_t {
+    enum Type: uint16_t {
         _1   = BIT(0), _2  = BIT(1), _3    = BIT(2), _4   = BIT(3),
         _Bool = BIT(4), _Int = BIT(5), _Float = BIT(6), _Mat = BIT(7),
-        _Nb = _1 | _2 | _3 | _4, _Type = _Bool | _Int | _Float | _Mat,
+        _Half = BIT(8), _Short = BIT(9), _Packed = BIT(10),
+        _Nb = _1 | _2 | _3 | _4, _Type = _Bool | _Int | _Float | _Mat | _Half | _Short | _Packed,
         Bool  = _Bool  | _1,
         Int   = _Int   | _1, Int2   = _Int   | _2, Int3   = _Int   | _3, Int4   = _Int   | _4,
         Float = _Float | _1, Float2 = _Float | _2, Float3 = _Float | _3, Float4 = _Float | _4,
                              Mat2  =  _Mat   | _2, Mat3   = _Mat   | _3, Mat4   = _Mat   | _4,
+                             Half2  = _Half  | _2,                      Half4  = _Half  | _4,
+                             Short2 = _Short | _2,                      Short4 = _Short | _4,
+                                                                        Packed4 = _Packed | _4,
     };
 
     GLenum gl_type;
     std::size_t nb, size;
+    std::size_t nb_attribs; // Matrices take one attribute slot per column
     bool normalized;
 
-    constexpr BufferElement(): gl_type(0), nb(0), size(0), normalized(0) { }
+    constexpr BufferElement(): gl_type(0), nb(0), size(0), nb_attribs(0), normalized(0) { }
     constexpr BufferElement(Type type, bool normalized = false):
-        gl_type(get_gl_type(type)), nb(get_nb(type)), size(get_size(type)), normalized(normalized) { }
+        gl_type(get_gl_type(type)), nb(get_nb(type)), size(get_size(type)),
+        nb_attribs(get_nb_attribs(type)), normalized(normalized) { }
 
     static constexpr std::size_t get_size(Type type) {
-        return ((type & Type::_Bool) ? 1 : 4) * get_nb(type);
+        if (type & Type::_Packed)
+            return 4;
+        return ((type & Type::_Bool) ? 1 : (type & (Type::_Half | Type::_Short)) ? 2 : 4) * get_nb(type);
     }
 
     static constexpr std::size_t get_nb(Type type) {
-        if (type & Type::_Mat)
-            return (type & Type::_Nb) * (type & Type::_Nb);
-        return __builtin_ffs(type & Type::_Nb);
+        std::size_t n = __builtin_ffs(type & Type::_Nb);
+        return (type & Type::_Mat) ? n * n : n;
+    }
+
+    static constexpr std::size_t get_nb_attribs(Type type) {
+        return (type & Type::_Mat) ? __builtin_ffs(type & Type::_Nb) : 1;
     }
 
     static constexpr GLenum get_gl_type(Type type) {
         if      (type & Type::_Bool)                 return GL_BOOL;
         else if (type & Type::_Int)                  return GL_INT;
         else if (type & (Type::_Float | Type::_Mat)) return GL_FLOAT;
+        else if (type & Type::_Half)                 return GL_HALF_FLOAT;
+        else if (type & Type::_Short)                return GL_SHORT;
+        else if (type & Type::_Packed)               return GL_INT_2_10_10_10_REV;
     }
 };
 
+// A divisor of 0 advances the stream per vertex, n > 0 every n instances
 struct BufferLayout {
-    constexpr BufferLayout(std::initializer_list<BufferElement> &&elements):
-        elements(elements), stride(get_stride(std::forward<std::initializer_list<BufferElement>>(elements))) { }
+    constexpr BufferLayout(std::initializer_list<BufferElement> &&elements, GLuint divisor = 0):
+        elements(elements), stride(get_stride(std::forward<std::initializer_list<BufferElement>>(elements))), divisor(divisor) { }
 
     static constexpr std::size_t get_stride(std::initializer_list<BufferElement> &&elements) {
         std::size_t stride = 0;
@@ -55,58 +76,191 @@ struct BufferLayout {
         return stride;
     }
 
+    constexpr std::size_t get_nb_attribs() const {
+        std::size_t nb_attribs = 0;
+        for (auto &element: elements)
+            nb_attribs += element.nb_attribs;
+        return nb_attribs;
+    }
+
     std::initializer_list<BufferElement> elements;
     std::size_t stride;
+    GLuint divisor;
 };
 
+// How Buffer::update writes a range of the storage
+enum class BufferUpdate {
+    SubData,           // glBufferSubData: the driver copies the data, and waits if the GPU still reads the range
+    MapUnsynchronized, // Mapped with invalidate-range and no synchronization: the range must not be in use by the GPU
+    Orphan,            // The storage is reallocated first, so the GPU keeps the old one: the rest of the contents is lost
+};
+
+// Edits never depend on, nor change, the binding of Type: they go through DSA when the context has it
+// (see GlState), otherwise through the GL_COPY_WRITE_BUFFER binding point
+// In particular, editing an element buffer leaves the element buffer of the bound vertex array alone
 template <GLenum Type, std::size_t N = 1>
 class Buffer: public GlObject {
     public:
         Buffer() {
-            glGenBuffers(get_nb(), &this->handle);
+            if (GlState::has_dsa())
+                glCreateBuffers(get_nb(), &this->handle);
+            else
+                glGenBuffers(get_nb(), &this->handle);
             if (!get_handle())
                 throw std::runtime_error("Could not create Buffer object");
-            bind();
         }
 
         ~Buffer() {
+            GlState::forget_buffer(get_handle());
             glDeleteBuffers(get_nb(), &this->handle);
         }
 
         void set_data(const void *data, std::size_t size, GLenum draw_type = GL_STATIC_DRAW) {
-            this->size = size;
-            glBufferData(get_type(), size, data, draw_type);
+            if (is_immutable())
+                throw std::runtime_error("Buffer storage is immutable");
+            this->size = size, this->draw_type = draw_type;
+            if (GlState::has_dsa())
+                glNamedBufferData(get_handle(), size, data, draw_type);
+            else
+                bind_for_edit(), glBufferData(edit_target, size, data, draw_type);
+        }
+
+        void set_sub_data(const void *data, std::size_t size, std::size_t off = 0) {
+            if (GlState::has_dsa())
+                glNamedBufferSubData(get_handle(), off, size, data);
+            else
+                bind_for_edit(), glBufferSubData(edit_target, off, size, data);
+        }
+
+        // Immutable storage (ARB_buffer_storage), which set_data can't respecify
+        void set_storage(const void *data, std::size_t size, GLbitfield flags) {
+            this->size = size, this->storage_flags = flags | storage_immutable;
+            if (GlState::has_dsa())
+                glNamedBufferStorage(get_handle(), size, data, flags);
+            else
+                bind_for_edit(), glBufferStorage(edit_target, size, data, flags);
+        }
+
+        // Copies [src_off, src_off + size) of src to dst_off
+        void copy_sub_data(const GlObject &src, std::size_t size, std::size_t src_off = 0, std::size_t dst_off = 0) {
+            if (GlState::has_dsa()) {
+                glCopyNamedBufferSubData(src.get_handle(), get_handle(), src_off, dst_off, size);
+            } else {
+                GlState::bind_buffer(GL_COPY_READ_BUFFER, src.get_handle());
+                bind_for_edit();
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, edit_target, src_off, dst_off, size);
+            }
+        }
+
+        // Writes [off, off + size) of the storage allocated by set_data
+        // Orphan keeps the size and usage of the storage, and only refills the given range
+        // Immutable storage can't be orphaned, takes SubData only with GL_DYNAMIC_STORAGE_BIT, and can't be mapped
+        // again while persistently mapped (as a StreamBuffer is): such requests throw
+        void update(const void *data, std::size_t size, std::size_t off = 0, BufferUpdate strategy = BufferUpdate::SubData) {
+            if (!supports(strategy))
+                throw std::runtime_error("Update strategy not supported by the Buffer storage");
+
+            switch (strategy) {
+                case BufferUpdate::SubData:
+                    set_sub_data(data, size, off);
+                    break;
+                case BufferUpdate::MapUnsynchronized: {
+                    void *dst = map(off, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+                    if (!dst)
+                        throw std::runtime_error("Could not map Buffer range");
+                    std::memcpy(dst, data, size);
+                    unmap();
+                    break;
+                }
+                case BufferUpdate::Orphan:
+                    if (!off && (size == this->size)) {
+                        set_data(data, size, this->draw_type);
+                    } else {
+                        set_data(nullptr, this->size, this->draw_type);
+                        set_sub_data(data, size, off);
+                    }
+                    break;
+            }
+        }
+
+        bool supports(BufferUpdate strategy) const {
+            if (!is_immutable())
+                return true;
+            switch (strategy) {
+                case BufferUpdate::SubData:
+                    return this->storage_flags & GL_DYNAMIC_STORAGE_BIT;
+                case BufferUpdate::MapUnsynchronized:
+                    return (this->storage_flags & GL_MAP_WRITE_BIT) && !(this->storage_flags & GL_MAP_PERSISTENT_BIT);
+                default:
+                    return false;
+            }
         }
 
         void bind() const {
-            glBindBuffer(get_type(), get_handle());
+            bind(get_handle());
         }
 
         static void bind(GLuint handle) {
-            glBindBuffer(get_type(), handle);
+            GlState::bind_buffer(get_type(), handle);
         }
 
         static void unbind() {
-            glBindBuffer(get_type(), 0);
+            bind(0);
+        }
+
+        void *map(GLintptr off, GLsizeiptr size, GLbitfield access) {
+            if (GlState::has_dsa())
+                return glMapNamedBufferRange(get_handle(), off, size, access);
+            bind_for_edit();
+            return glMapBufferRange(edit_target, off, size, access);
+        }
+
+        bool unmap() {
+            if (GlState::has_dsa())
+                return glUnmapNamedBuffer(get_handle());
+            bind_for_edit();
+            return glUnmapBuffer(edit_target);
         }
 
         static inline std::size_t get_nb()         { return N; }
         static inline GLenum      get_type()       { return Type; }
-        inline std::size_t        get_size() const { return this->size; }
+        inline std::size_t        get_size()     const { return this->size; }
+        inline bool               is_immutable() const { return this->storage_flags & storage_immutable; }
 
     protected:
-        std::size_t size;
+        static constexpr GLenum edit_target = GL_COPY_WRITE_BUFFER;
+
+        // Not a GL flag, marks storage allocated by set_storage
+        static constexpr GLbitfield storage_immutable = 1u << 31;
+
+        std::size_t size = 0;
+        GLenum draw_type = GL_STATIC_DRAW;  // Usage of mutable storage
+        GLbitfield storage_flags = 0;       // Flags of immutable storage
+
+        void bind_for_edit() const {
+            GlState::bind_buffer(edit_target, get_handle());
+        }
 };
 
 template <std::size_t N = 1>
 class VertexBuffer: public Buffer<GL_ARRAY_BUFFER, N> {
     public:
-        static void set_layout(BufferLayout &&layout) {
-            std::size_t i = 0, off = 0;
+        // Attributes are specified on the bound vertex array, and read the buffer bound to GL_ARRAY_BUFFER
+        // This is what VertexArray::set_layout does without DSA
+        // Streams sharing a vertex array are laid out one after the other, starting at first_attrib
+        // The attributes start base_off bytes into the buffer (eg. the current region of a StreamBuffer)
+        // Returns the first attribute index past this layout
+        static GLuint set_layout(BufferLayout &&layout, GLuint first_attrib = 0, std::uintptr_t base_off = 0) {
+            std::size_t i = first_attrib, off = base_off;
             for (auto &element: layout.elements) {
-                set_attrib_ptr(i, element.nb, element.gl_type, layout.stride, (GLvoid *)off, element.normalized);
-                off += element.size; ++i;
+                std::size_t nb = element.nb / element.nb_attribs, size = element.size / element.nb_attribs;
+                for (std::size_t j = 0; j < element.nb_attribs; ++j) {
+                    set_attrib_ptr(i, nb, element.gl_type, layout.stride, (GLvoid *)off, element.normalized);
+                    set_attrib_divisor(i, layout.divisor);
+                    off += size; ++i;
+                }
             }
+            return i;
         }
 
         static void set_attrib_ptr(GLuint pos, GLuint size, GLenum type, GLuint stride = 0, GLvoid *off = nullptr, bool normalize = false) {
@@ -114,6 +268,10 @@ class VertexBuffer: public Buffer<GL_ARRAY_BUFFER, N> {
             enable_attrib_arr(pos);
         }
 
+        static void set_attrib_divisor(GLuint pos, GLuint divisor) {
+            glVertexAttribDivisor(pos, divisor);
+        }
+
         static void enable_attrib_arr(GLuint pos) {
             glEnableVertexAttribArray(pos);
         }
@@ -125,3 +283,118 @@ class VertexBuffer: public Buffer<GL_ARRAY_BUFFER, N> {
 
 template <std::size_t N = 1>
 class ElementBuffer: public Buffer<GL_ELEMENT_ARRAY_BUFFER, N> { };
+
+template <std::size_t N = 1>
+class PixelUnpackBuffer: public Buffer<GL_PIXEL_UNPACK_BUFFER, N> { };
+
+template <std::size_t N = 1>
+class DrawIndirectBuffer: public Buffer<GL_DRAW_INDIRECT_BUFFER, N> { };
+
+// Ring of regions for per-frame data: the CPU writes one region while the GPU reads the previous ones,
+// and a fence per region stops the CPU from overwriting data that is still in flight
+// With ARB_buffer_storage, the storage is mapped once (persistent and coherent) and written in place,
+// otherwise each region is mapped unsynchronized for the time of the writes
+// Usage per frame: begin(), write, end() to get the region offset, issue the draws, then fence()
+template <GLenum Type>
+class StreamBuffer: public Buffer<Type> {
+    public:
+        static constexpr std::size_t nb_regions = 3;
+
+        // Regions are padded to alignment, which must satisfy the binding point (eg. the uniform buffer offset alignment)
+        StreamBuffer(std::size_t region_size, std::size_t alignment = 256):
+                region_size((region_size + alignment - 1) / alignment * alignment),
+                persistent(is_persistent_supported()) {
+            std::size_t size = this->region_size * nb_regions;
+            if (this->persistent) {
+                constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                this->set_storage(nullptr, size, flags);
+                this->mapping = (std::uint8_t *)this->map(0, size, flags);
+                if (!this->mapping)
+                    throw std::runtime_error("Could not map StreamBuffer storage");
+            } else {
+                this->set_data(nullptr, size, GL_STREAM_DRAW);
+            }
+        }
+
+        ~StreamBuffer() {
+            for (GLsync fence: this->fences)
+                if (fence)
+                    glDeleteSync(fence);
+        }
+
+        // Waits for the GPU to release the current region, and returns where to write it
+        void *begin() {
+            if (GLsync &fence = this->fences[this->region]) {
+                GLenum rc = glClientWaitSync(fence, 0, 0);
+                if ((rc != GL_ALREADY_SIGNALED) && (rc != GL_CONDITION_SATISFIED)) {
+                    ++this->nb_stalls;
+                    while (((rc = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000)) == GL_TIMEOUT_EXPIRED));
+                }
+                glDeleteSync(fence), fence = nullptr;
+            }
+
+            if (this->persistent)
+                return this->mapping + get_offset();
+            return this->map(get_offset(), this->region_size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        }
+
+        // Returns the byte offset of the region that was just written
+        std::size_t end() {
+            if (!this->persistent)
+                this->unmap();
+            return get_offset();
+        }
+
+        // To call once the draws reading the region have been issued, moves on to the next region
+        void fence() {
+            if (this->fences[this->region])
+                glDeleteSync(this->fences[this->region]);
+            this->fences[this->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            this->region = (this->region + 1) % nb_regions;
+        }
+
+        inline std::size_t get_offset()      const { return this->region * this->region_size; }
+        inline std::size_t get_region_size() const { return this->region_size; }
+        inline bool        is_persistent()   const { return this->persistent; }
+        inline std::size_t get_nb_stalls()   const { return this->nb_stalls; } // Times begin() had to wait for the GPU
+
+        static inline bool is_persistent_supported() { return GLAD_GL_ARB_buffer_storage; }
+
+    protected:
+        std::size_t region_size;
+        bool persistent;
+        std::uint8_t *mapping = nullptr;
+        std::size_t region = 0, nb_stalls = 0;
+        GLsync fences[nb_regions] = {};
+};
+
+// Storage for a uniform block, mirrored by a C++ struct laid out like the std140 block
+// Programs share the block by binding it to the same index (see ShaderProgram::bind_uniform_block)
+template <typename T>
+class UniformBuffer: public Buffer<GL_UNIFORM_BUFFER> {
+    static_assert(std::is_trivially_copyable_v<T>, "Uniform block mirror must be trivially copyable");
+
+    public:
+        UniformBuffer(GLuint binding, GLenum draw_type = GL_DYNAMIC_DRAW): binding(binding) {
+            set_data(nullptr, sizeof(T), draw_type);
+            bind_base();
+        }
+
+        // Uploads the whole mirror in one call
+        void update() {
+            set_sub_data(&this->data, sizeof(T));
+        }
+
+        void bind_base() const {
+            GlState::bind_buffer_base(get_type(), this->binding, get_handle());
+        }
+
+        inline T       &get()             { return this->data; }
+        inline const T &get()       const { return this->data; }
+        inline T       *operator->()      { return &this->data; }
+        inline GLuint   get_binding() const { return this->binding; }
+
+    protected:
+        T data = {};
+        GLuint binding;
+};
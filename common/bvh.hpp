@@ -0,0 +1,259 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "aabb.hpp"
+#include "frustum.hpp"
+#include "render_stats.hpp"
+#include "utils.hpp"
+
+// Bounding volume hierarchy over a set of boxes (primitives), built with the binned surface area heuristic
+// Nodes are stored depth-first in a flat array: the left child of an interior node directly follows it,
+// so a traversal mostly walks forward in memory, and only the right child index needs storing
+class Bvh {
+    public:
+        static constexpr std::size_t nb_bins = 16, max_depth = 64;
+
+        struct Node {
+            Aabb bounds;
+            std::uint32_t offset; // Right child for interior nodes, first primitive index for leaves
+            std::uint32_t count;  // Number of primitives, 0 for interior nodes
+
+            inline bool is_leaf() const { return this->count; }
+        };
+        ASSERT_SIZE(Node, 32);
+
+        struct Hit {
+            std::uint32_t prim;
+            float t;
+        };
+
+        Bvh() = default;
+        Bvh(const Aabb *boxes, std::size_t n, std::size_t max_leaf_size = 4) {
+            build(boxes, n, max_leaf_size);
+        }
+
+        void build(const Aabb *boxes, std::size_t n, std::size_t max_leaf_size = 4) {
+            this->nodes.clear();
+            this->prims.resize(n);
+            this->centroids.resize(n);
+            this->boxes.assign(boxes, boxes + n);
+            this->max_leaf_size = std::max(max_leaf_size, (std::size_t)1);
+            for (std::size_t i = 0; i < n; ++i)
+                this->prims[i] = i, this->centroids[i] = boxes[i].get_center();
+
+            if (!n)
+                return;
+            this->nodes.reserve(2 * n - 1);
+            build_node(0, n, 0);
+            this->centroids.clear(), this->centroids.shrink_to_fit();
+        }
+
+        // Calls visit(prim) for every primitive whose box intersects the frustum
+        // Subtrees entirely inside the frustum are accepted without testing their boxes
+        template <typename F>
+        std::size_t cull(const Frustum &frustum, F &&visit) const {
+            if (this->nodes.empty())
+                return 0;
+
+            std::size_t nb_visible = 0;
+            std::pair<std::uint32_t, bool> stack[max_depth];
+            std::size_t stack_size = 0;
+            stack[stack_size++] = {0, false};
+            while (stack_size) {
+                auto [idx, inside] = stack[--stack_size];
+                auto &node = this->nodes[idx];
+                if (!inside) {
+                    auto res = frustum.classify(node.bounds);
+                    if (res == Frustum::Containment::Outside)
+                        continue;
+                    inside = res == Frustum::Containment::Inside;
+                }
+
+                if (node.is_leaf()) {
+                    for (std::uint32_t i = 0; i < node.count; ++i) {
+                        std::uint32_t prim = this->prims[node.offset + i];
+                        if (inside || frustum.test(this->boxes[prim]))
+                            visit(prim), ++nb_visible;
+                    }
+                } else {
+                    stack[stack_size++] = {node.offset, inside};
+                    stack[stack_size++] = {idx + 1,     inside};
+                }
+            }
+
+            auto &stats = RenderStats::get();
+            stats.nb_visible += nb_visible, stats.nb_culled += this->prims.size() - nb_visible;
+            return nb_visible;
+        }
+
+        // Closest primitive along the ray, as decided by intersect(prim, t_max), which returns
+        // the distance to the primitive or infinity on a miss
+        // The default reports the distance to the primitive's box
+        template <typename F>
+        bool raycast(const glm::vec3 &origin, const glm::vec3 &dir, Hit &hit, F &&intersect) const {
+            hit = { (std::uint32_t)-1, std::numeric_limits<float>::infinity() };
+            if (this->nodes.empty())
+                return false;
+
+            glm::vec3 inv_dir = 1.0f / dir;
+            std::uint32_t stack[max_depth];
+            std::size_t stack_size = 0;
+            stack[stack_size++] = 0;
+            while (stack_size) {
+                auto &node = this->nodes[stack[--stack_size]];
+                if (node.is_leaf()) {
+                    for (std::uint32_t i = 0; i < node.count; ++i) {
+                        std::uint32_t prim = this->prims[node.offset + i];
+                        float t = intersect(prim, hit.t);
+                        if (t < hit.t)
+                            hit = { prim, t };
+                    }
+                    continue;
+                }
+
+                // Visit the nearest child first, so the farther one is more likely to be rejected
+                std::uint32_t left = &node - this->nodes.data() + 1, right = node.offset;
+                float t_left  = intersect_box(this->nodes[left].bounds,  origin, inv_dir, hit.t);
+                float t_right = intersect_box(this->nodes[right].bounds, origin, inv_dir, hit.t);
+                if (t_left > t_right)
+                    std::swap(left, right), std::swap(t_left, t_right);
+                if (t_right < hit.t)
+                    stack[stack_size++] = right;
+                if (t_left < hit.t)
+                    stack[stack_size++] = left;
+            }
+            return hit.prim != (std::uint32_t)-1;
+        }
+
+        bool raycast(const glm::vec3 &origin, const glm::vec3 &dir, Hit &hit) const {
+            glm::vec3 inv_dir = 1.0f / dir;
+            return raycast(origin, dir, hit, [&](std::uint32_t prim, float t_max) {
+                return intersect_box(this->boxes[prim], origin, inv_dir, t_max);
+            });
+        }
+
+        // Slab test, returns the entry distance (0 if the origin is inside) or infinity on a miss
+        static float intersect_box(const Aabb &box, const glm::vec3 &origin, const glm::vec3 &inv_dir, float t_max) {
+            glm::vec3 t0 = (box.min - origin) * inv_dir, t1 = (box.max - origin) * inv_dir;
+            glm::vec3 t_near = glm::min(t0, t1), t_far = glm::max(t0, t1);
+            float t_enter = std::max({t_near.x, t_near.y, t_near.z, 0.0f});
+            float t_exit  = std::min({t_far.x,  t_far.y,  t_far.z,  t_max});
+            return (t_enter <= t_exit) ? t_enter : std::numeric_limits<float>::infinity();
+        }
+
+        // Möller-Trumbore, returns the distance to the triangle (either side) or infinity on a miss
+        static float intersect_triangle(const glm::vec3 &origin, const glm::vec3 &dir,
+                const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2) {
+            constexpr float miss = std::numeric_limits<float>::infinity();
+            glm::vec3 e1 = p1 - p0, e2 = p2 - p0, p = glm::cross(dir, e2);
+            float det = glm::dot(e1, p);
+            if (std::abs(det) < 1e-12f)
+                return miss;
+
+            float inv_det = 1.0f / det;
+            glm::vec3 s = origin - p0, q = glm::cross(s, e1);
+            float u = glm::dot(s, p) * inv_det, v = glm::dot(dir, q) * inv_det;
+            if ((u < 0.0f) || (v < 0.0f) || (u + v > 1.0f))
+                return miss;
+            float t = glm::dot(e2, q) * inv_det;
+            return (t >= 0.0f) ? t : miss;
+        }
+
+        inline const std::vector<Node> &get_nodes() const { return this->nodes; }
+        inline const Aabb &get_bounds()             const { return this->nodes.front().bounds; }
+        inline bool is_empty()                      const { return this->nodes.empty(); }
+
+    private:
+        struct Bin {
+            Aabb bounds;
+            std::size_t count = 0;
+        };
+
+        std::uint32_t build_node(std::size_t first, std::size_t count, std::size_t depth) {
+            std::uint32_t idx = this->nodes.size();
+            this->nodes.push_back({});
+
+            Aabb bounds, centroid_bounds;
+            for (std::size_t i = first; i < first + count; ++i)
+                bounds.extend(this->boxes[this->prims[i]]), centroid_bounds.extend(this->centroids[this->prims[i]]);
+            this->nodes[idx].bounds = bounds;
+
+            auto make_leaf = [&] {
+                this->nodes[idx].offset = first, this->nodes[idx].count = count;
+                return idx;
+            };
+
+            if ((count <= 1) || (depth + 1 >= max_depth))
+                return make_leaf();
+
+            // Bin the centroids along each axis and sweep for the cheapest split
+            float best_cost = std::numeric_limits<float>::infinity();
+            int best_axis = -1;
+            std::size_t best_split = 0;
+            for (int axis = 0; axis < 3; ++axis) {
+                float lo = centroid_bounds.min[axis], extent = centroid_bounds.max[axis] - lo;
+                if (extent <= 0.0f)
+                    continue;
+
+                Bin bins[nb_bins];
+                float scale = nb_bins / extent;
+                for (std::size_t i = first; i < first + count; ++i) {
+                    std::uint32_t prim = this->prims[i];
+                    auto &bin = bins[get_bin(this->centroids[prim][axis], lo, scale)];
+                    bin.bounds.extend(this->boxes[prim]), ++bin.count;
+                }
+
+                // Right-to-left pass for the right side costs, then left-to-right for the total
+                float right_cost[nb_bins];
+                Aabb acc;
+                std::size_t acc_count = 0;
+                for (std::size_t i = nb_bins - 1; i > 0; --i) {
+                    acc.extend(bins[i].bounds), acc_count += bins[i].count;
+                    right_cost[i] = acc_count ? acc.get_surface_area() * acc_count : 0.0f;
+                }
+                acc = {}, acc_count = 0;
+                for (std::size_t i = 0; i < nb_bins - 1; ++i) {
+                    acc.extend(bins[i].bounds), acc_count += bins[i].count;
+                    float cost = (acc_count ? acc.get_surface_area() * acc_count : 0.0f) + right_cost[i + 1];
+                    if (cost < best_cost)
+                        best_cost = cost, best_axis = axis, best_split = i + 1;
+                }
+            }
+
+            // Leaf if splitting doesn't beat testing every primitive (with a traversal cost of one box test)
+            float leaf_cost = count, split_cost = 1.0f + best_cost / bounds.get_surface_area();
+            if ((best_axis < 0) || ((count <= this->max_leaf_size) && (leaf_cost <= split_cost)))
+                return make_leaf();
+
+            float lo = centroid_bounds.min[best_axis], scale = nb_bins / (centroid_bounds.max[best_axis] - lo);
+            auto mid = std::partition(this->prims.begin() + first, this->prims.begin() + first + count,
+                [&](std::uint32_t prim) { return get_bin(this->centroids[prim][best_axis], lo, scale) < best_split; });
+            std::size_t left_count = mid - (this->prims.begin() + first);
+            if (!left_count || (left_count == count))
+                return make_leaf();
+
+            build_node(first, left_count, depth + 1);
+            std::uint32_t right = build_node(first + left_count, count - left_count, depth + 1);
+            this->nodes[idx].offset = right, this->nodes[idx].count = 0;
+            return idx;
+        }
+
+        static inline std::size_t get_bin(float val, float lo, float scale) {
+            return std::min((std::size_t)((val - lo) * scale), nb_bins - 1);
+        }
+
+    protected:
+        std::vector<Node> nodes;
+        std::vector<std::uint32_t> prims;
+        std::vector<Aabb> boxes;
+        std::vector<glm::vec3> centroids;
+        std::size_t max_leaf_size = 4;
+};
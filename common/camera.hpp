@@ -8,6 +8,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "frustum.hpp"
+
 class Camera {
     public:
         enum class Movement: uint8_t {
@@ -69,6 +71,14 @@ class Camera {
             update();
         }
 
+        void look_at(const glm::vec3 &pos, const glm::vec3 &target) {
+            this->pos   = pos;
+            this->front = glm::normalize(target - pos);
+            this->yaw   = glm::degrees(std::atan2(this->front.x, this->front.z));
+            this->pitch = glm::degrees(std::asin(this->front.y));
+            update();
+        }
+
         void zoom(float z) {
             this->fov -= z;
             this->fov = std::clamp(this->fov, 1.0f, 45.0f);
@@ -87,6 +97,10 @@ class Camera {
             return this->view_proj;
         }
 
+        inline const Frustum &get_frustum() const {
+            return this->frustum;
+        }
+
         inline const glm::vec3 &get_pos()   const { return this->pos; }
         inline const glm::vec3 &get_front() const { return this->front; }
 
@@ -94,6 +108,7 @@ class Camera {
             this->proj = glm::perspective(glm::radians(this->fov), this->scr_w / this->scr_h, 0.1f, 100.0f);
             this->view = glm::lookAt(this->pos, this->pos + this->front, glm::vec3(0.0f, 1.0f, 0.0f));
             this->view_proj = this->proj * this->view;
+            this->frustum.set(this->view_proj);
         }
 
         inline void    set_speed(GLfloat speed)                    { this->speed = speed; }
@@ -107,4 +122,5 @@ class Camera {
         GLfloat yaw, pitch, fov, speed, sensitivity;
         float scr_w = 1, scr_h = 1, mouse_x = NAN, mouse_y = NAN;;
         glm::mat4 view, proj, view_proj;
+        Frustum frustum;
 };
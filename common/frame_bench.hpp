@@ -0,0 +1,276 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <iostream>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "window.hpp"
+#include "camera.hpp"
+#include "shader_program.hpp"
+#include "render_stats.hpp"
+
+// Reproducible frame-time measurements of a render loop:
+// the camera follows a scripted path on a fixed timestep, and per-frame CPU/GPU times
+// and draw/state counters are summarized as JSON
+// Demos enable it with: --bench [--frames N] [--warmup N] [--out path.json]
+struct BenchOptions {
+    bool enabled = false;
+    std::size_t nb_frames = 600, nb_warmup = 30;
+    double timestep = 1.0 / 60.0;
+    std::string out_path;
+
+    static BenchOptions parse(int argc, char **argv) {
+        BenchOptions opts;
+        for (int i = 1; i < argc; ++i) {
+            bool has_val = i + 1 < argc;
+            if (!std::strcmp(argv[i], "--bench"))
+                opts.enabled = true;
+            else if (!std::strcmp(argv[i], "--frames") && has_val)
+                opts.nb_frames = std::max(std::atol(argv[++i]), 1l);
+            else if (!std::strcmp(argv[i], "--warmup") && has_val)
+                opts.nb_warmup = std::max(std::atol(argv[++i]), 0l);
+            else if (!std::strcmp(argv[i], "--out") && has_val)
+                opts.out_path = argv[++i];
+        }
+        return opts;
+    }
+};
+
+// Closed Catmull-Rom spline through camera keyframes, traversed once per period
+class CameraPath {
+    public:
+        struct Key {
+            glm::vec3 pos, target;
+        };
+
+        CameraPath(std::vector<Key> keys, double period): keys(std::move(keys)), period(period) { }
+
+        // Keyframes around center, alternating between two heights
+        static CameraPath orbit(const glm::vec3 &center, float radius, float height, std::size_t nb_keys, double period) {
+            std::vector<Key> keys;
+            for (std::size_t i = 0; i < nb_keys; ++i) {
+                float angle = 2.0f * (float)M_PI * i / nb_keys;
+                float y = (i & 1) ? height : -0.5f * height;
+                keys.push_back({center + glm::vec3(radius * std::sin(angle), y, radius * std::cos(angle)), center});
+            }
+            return CameraPath(std::move(keys), period);
+        }
+
+        void apply(Camera &camera, double time) const {
+            double pos = std::fmod(time / this->period, 1.0) * this->keys.size();
+            std::size_t i = (std::size_t)pos;
+            float t = pos - i;
+            camera.look_at(interpolate(i, t, &Key::pos), interpolate(i, t, &Key::target));
+        }
+
+    private:
+        glm::vec3 interpolate(std::size_t i, float t, glm::vec3 Key::*member) const {
+            std::size_t n = this->keys.size();
+            const glm::vec3 &p0 = this->keys[(i + n - 1) % n].*member, &p1 = this->keys[i % n].*member,
+                            &p2 = this->keys[(i + 1) % n].*member,     &p3 = this->keys[(i + 2) % n].*member;
+            float t2 = t * t, t3 = t2 * t;
+            return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2
+                + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+        }
+
+    protected:
+        std::vector<Key> keys;
+        double period;
+};
+
+class FrameRecorder {
+    public:
+        struct Frame {
+            double cpu_ms, gpu_ms;
+            RenderStats stats;
+            ShaderProgram::UniformStats uniforms;
+        };
+
+        FrameRecorder(std::size_t nb_frames = 0) {
+            glGenQueries(nb_queries, this->queries);
+            this->frames.reserve(nb_frames);
+        }
+
+        ~FrameRecorder() {
+            glDeleteQueries(nb_queries, this->queries);
+        }
+
+        void begin_frame() {
+            RenderStats::reset();
+            ShaderProgram::reset_uniform_stats();
+            glBeginQuery(GL_TIME_ELAPSED, this->queries[this->frames.size() % nb_queries]);
+            this->start = Clock::now();
+        }
+
+        void end_frame() {
+            glEndQuery(GL_TIME_ELAPSED);
+            double cpu_ms = std::chrono::duration<double, std::milli>(Clock::now() - this->start).count();
+            this->frames.push_back({cpu_ms, 0.0, RenderStats::get(), ShaderProgram::get_uniform_stats()});
+
+            // Query results are collected a few frames late so the CPU doesn't wait for the GPU,
+            // just before the query object gets reused
+            if (this->frames.size() >= nb_queries)
+                read_gpu_time(this->frames.size() - nb_queries);
+        }
+
+        // Collects the outstanding GPU timings, call once after the last frame
+        void finish() {
+            std::size_t n = this->frames.size();
+            for (std::size_t i = (n >= nb_queries) ? n - nb_queries + 1 : 0; i < n; ++i)
+                read_gpu_time(i);
+        }
+
+        void clear() {
+            finish();
+            this->frames.clear();
+        }
+
+        inline const std::vector<Frame> &get_frames() const { return this->frames; }
+
+        std::string to_json(const std::string &name, double timestep) const {
+            std::string json = "{\n";
+            auto add = [&json](const char *key, const std::string &val, bool last = false) {
+                json += "  \"" + std::string(key) + "\": " + val + (last ? "\n" : ",\n");
+            };
+            auto summarize = [this](auto &&get) {
+                std::vector<double> vals;
+                vals.reserve(this->frames.size());
+                for (auto &frame: this->frames)
+                    vals.push_back(get(frame));
+                return get_summary(vals);
+            };
+
+            add("name",            '"' + name + '"');
+            add("renderer",        '"' + std::string((const char *)glGetString(GL_RENDERER)) + '"');
+            add("nb_frames",       std::to_string(this->frames.size()));
+            add("timestep_ms",     format(timestep * 1e3));
+            add("cpu_ms",          summarize([](const Frame &f) { return f.cpu_ms; }));
+            add("gpu_ms",          summarize([](const Frame &f) { return f.gpu_ms; }));
+            add("draws",           summarize([](const Frame &f) { return (double)f.stats.nb_draws; }));
+            add("instances",       summarize([](const Frame &f) { return (double)f.stats.nb_instances; }));
+            add("state_changes",   summarize([](const Frame &f) { return (double)f.stats.get_nb_state_changes(); }));
+            add("visible",         summarize([](const Frame &f) { return (double)f.stats.nb_visible; }));
+            add("culled",          summarize([](const Frame &f) { return (double)f.stats.nb_culled; }));
+            add("uniforms",        summarize([](const Frame &f) { return (double)f.uniforms.issued; }));
+            add("uniforms_elided", summarize([](const Frame &f) { return (double)f.uniforms.elided; }));
+
+            std::string frames = "[";
+            for (std::size_t i = 0; i < this->frames.size(); ++i) {
+                auto &frame = this->frames[i];
+                frames += (i ? ",\n    " : "\n    ") + std::string("{ \"cpu_ms\": ") + format(frame.cpu_ms)
+                    + ", \"gpu_ms\": " + format(frame.gpu_ms) + ", \"draws\": " + std::to_string(frame.stats.nb_draws)
+                    + ", \"state_changes\": " + std::to_string(frame.stats.get_nb_state_changes())
+                    + ", \"visible\": " + std::to_string(frame.stats.nb_visible) + " }";
+            }
+            add("frames", frames + "\n  ]", true);
+            return json + "}\n";
+        }
+
+        bool write_json(const std::string &path, const std::string &name, double timestep) const {
+            std::string json = to_json(name, timestep);
+            if (path.empty()) {
+                std::cout << json;
+                return true;
+            }
+            std::FILE *fp = std::fopen(path.c_str(), "w");
+            if (!fp) {
+                std::cout << "Could not open " << path << '\n';
+                return false;
+            }
+            std::fwrite(json.data(), 1, json.size(), fp);
+            std::fclose(fp);
+            return true;
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        static constexpr std::size_t nb_queries = 4;
+
+        void read_gpu_time(std::size_t idx) {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(this->queries[idx % nb_queries], GL_QUERY_RESULT, &ns);
+            this->frames[idx].gpu_ms = ns / 1e6;
+        }
+
+        static std::string format(double val) {
+            char buf[0x20];
+            std::snprintf(buf, sizeof(buf), "%.4f", val);
+            return buf;
+        }
+
+        // Nearest-rank percentiles
+        static std::string get_summary(std::vector<double> vals) {
+            if (vals.empty())
+                return "{}";
+            std::sort(vals.begin(), vals.end());
+            auto percentile = [&vals](double p) {
+                std::size_t rank = (std::size_t)std::ceil(p / 100.0 * vals.size());
+                return vals[std::clamp(rank, (std::size_t)1, vals.size()) - 1];
+            };
+            double sum = 0.0;
+            for (double val: vals)
+                sum += val;
+            return "{ \"mean\": " + format(sum / vals.size()) + ", \"min\": " + format(vals.front())
+                + ", \"p50\": " + format(percentile(50)) + ", \"p95\": " + format(percentile(95))
+                + ", \"p99\": " + format(percentile(99)) + ", \"max\": " + format(vals.back()) + " }";
+        }
+
+    protected:
+        GLuint queries[nb_queries];
+        std::vector<Frame> frames;
+        Clock::time_point start;
+};
+
+// Glue for demo main loops, every call is a no-op unless --bench was passed
+class FrameBench {
+    public:
+        FrameBench(int argc, char **argv, Window &window, CameraPath path):
+                opts(BenchOptions::parse(argc, argv)), window(window), path(std::move(path)) {
+            if (!this->opts.enabled)
+                return;
+            this->recorder.emplace(this->opts.nb_frames);
+            Window::set_vsync(false);
+            Window::set_fixed_timestep(this->opts.timestep);
+            this->window.set_max_frames(this->opts.nb_warmup + this->opts.nb_frames);
+        }
+
+        void begin_frame(Camera &camera) {
+            if (!this->recorder)
+                return;
+            if (this->window.get_nb_frames() == this->opts.nb_warmup)
+                this->recorder->clear();
+            this->path.apply(camera, Window::get_time());
+            this->recorder->begin_frame();
+        }
+
+        void end_frame() {
+            if (this->recorder)
+                this->recorder->end_frame();
+        }
+
+        // Writes the JSON report to the --out path, or stdout
+        bool report(const std::string &name) {
+            if (!this->recorder)
+                return true;
+            this->recorder->finish();
+            return this->recorder->write_json(this->opts.out_path, name, this->opts.timestep);
+        }
+
+        inline bool is_enabled() const { return this->opts.enabled; }
+
+    protected:
+        BenchOptions opts;
+        Window &window;
+        CameraPath path;
+        std::optional<FrameRecorder> recorder;
+};
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <glm/glm.hpp>
+#ifdef __SSE__
+#   include <immintrin.h>
+#endif
+
+#include "aabb.hpp"
+#include "render_stats.hpp"
+
+// View frustum as 6 inward-facing planes (Gribb-Hartmann extraction from a view-projection matrix)
+// A box is culled when it lies entirely behind one of the planes: this is conservative,
+// boxes near the frustum corners can be kept although they are outside
+class Frustum {
+    public:
+        enum class Containment: std::uint8_t {
+            Outside,
+            Intersect,
+            Inside,
+        };
+
+        Frustum() = default;
+        Frustum(const glm::mat4 &view_proj) {
+            set(view_proj);
+        }
+
+        void set(const glm::mat4 &view_proj) {
+            glm::vec4 rows[4];
+            for (int i = 0; i < 4; ++i)
+                rows[i] = glm::vec4(view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i]);
+            for (int i = 0; i < 3; ++i) {
+                this->planes[2 * i]     = rows[3] + rows[i];
+                this->planes[2 * i + 1] = rows[3] - rows[i];
+            }
+            for (auto &plane: this->planes)
+                plane /= glm::length(glm::vec3(plane));
+        }
+
+        bool test(const Aabb &box) const {
+            glm::vec3 center = box.get_center(), extent = box.get_extent();
+            for (auto &plane: this->planes) {
+                glm::vec3 normal(plane);
+                if (glm::dot(normal, center) + glm::dot(glm::abs(normal), extent) + plane.w < 0.0f)
+                    return false;
+            }
+            return true;
+        }
+
+        Containment classify(const Aabb &box) const {
+            glm::vec3 center = box.get_center(), extent = box.get_extent();
+            Containment res = Containment::Inside;
+            for (auto &plane: this->planes) {
+                glm::vec3 normal(plane);
+                float dist = glm::dot(normal, center) + plane.w, radius = glm::dot(glm::abs(normal), extent);
+                if (dist + radius < 0.0f)
+                    return Containment::Outside;
+                if (dist - radius < 0.0f)
+                    res = Containment::Intersect;
+            }
+            return res;
+        }
+
+        // Same frustum, with planes expressed in the object space of the given model matrix
+        // (a plane p in world space becomes transpose(model) * p), so object-space bounds can be tested directly
+        Frustum transform(const glm::mat4 &model) const {
+            Frustum res;
+            for (std::size_t i = 0; i < 6; ++i)
+                res.planes[i] = this->planes[i] * model;
+            return res;
+        }
+
+        // Writes 1 to visible[i] if boxes[i] intersects the frustum, 0 otherwise, and returns the number of visible boxes
+        // Counts are added to the RenderStats of the frame
+        std::size_t cull(const Aabb *boxes, std::size_t n, std::uint8_t *visible) const {
+            std::size_t i = 0, nb_visible = 0;
+#if defined(__SSE__)
+            // The builds don't enable AVX, so the 8-wide path is compiled for it alone and picked at run time
+            if (has_avx())
+                nb_visible += cull_avx(boxes, n, visible, i);
+
+            for (; i + 4 <= n; i += 4) {
+                __m128 v[6];
+                load_centers_extents(boxes + i, v);
+
+                __m128 outside = _mm_setzero_ps();
+                for (auto &plane: this->planes) {
+                    __m128 dist = _mm_add_ps(
+                        _mm_add_ps(_mm_mul_ps(v[0], _mm_set1_ps(plane.x)), _mm_mul_ps(v[1], _mm_set1_ps(plane.y))),
+                        _mm_add_ps(_mm_mul_ps(v[2], _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+                    __m128 radius = _mm_add_ps(
+                        _mm_add_ps(_mm_mul_ps(v[3], _mm_set1_ps(std::abs(plane.x))), _mm_mul_ps(v[4], _mm_set1_ps(std::abs(plane.y)))),
+                        _mm_mul_ps(v[5], _mm_set1_ps(std::abs(plane.z))));
+                    outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, radius), _mm_setzero_ps()));
+                }
+                nb_visible += store_mask(~_mm_movemask_ps(outside), 4, visible + i);
+            }
+#endif
+            for (; i < n; ++i)
+                nb_visible += visible[i] = test(boxes[i]);
+
+            auto &stats = RenderStats::get();
+            stats.nb_visible += nb_visible, stats.nb_culled += n - nb_visible;
+            return nb_visible;
+        }
+
+        inline const glm::vec4 &get_plane(std::size_t idx) const { return this->planes[idx]; }
+
+    private:
+        static std::size_t store_mask(int mask, std::size_t n, std::uint8_t *visible) {
+            std::size_t nb_visible = 0;
+            for (std::size_t i = 0; i < n; ++i)
+                nb_visible += visible[i] = (mask >> i) & 1;
+            return nb_visible;
+        }
+
+#ifdef __SSE__
+        static bool has_avx() {
+            static const bool res = (__builtin_cpu_init(), __builtin_cpu_supports("avx"));
+            return res;
+        }
+
+        // Culls blocks of 8 boxes from i on, and leaves i past the last one
+        __attribute__((target("avx")))
+        std::size_t cull_avx(const Aabb *boxes, std::size_t n, std::uint8_t *visible, std::size_t &i) const {
+            std::size_t nb_visible = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m128 lo[6], hi[6];
+                load_centers_extents(boxes + i, lo), load_centers_extents(boxes + i + 4, hi);
+                __m256 v[6];
+                for (int j = 0; j < 6; ++j)
+                    v[j] = _mm256_insertf128_ps(_mm256_castps128_ps256(lo[j]), hi[j], 1);
+
+                __m256 outside = _mm256_setzero_ps();
+                for (auto &plane: this->planes) {
+                    __m256 dist = _mm256_add_ps(
+                        _mm256_add_ps(_mm256_mul_ps(v[0], _mm256_set1_ps(plane.x)), _mm256_mul_ps(v[1], _mm256_set1_ps(plane.y))),
+                        _mm256_add_ps(_mm256_mul_ps(v[2], _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+                    __m256 radius = _mm256_add_ps(
+                        _mm256_add_ps(_mm256_mul_ps(v[3], _mm256_set1_ps(std::abs(plane.x))), _mm256_mul_ps(v[4], _mm256_set1_ps(std::abs(plane.y)))),
+                        _mm256_mul_ps(v[5], _mm256_set1_ps(std::abs(plane.z))));
+                    outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(dist, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+                }
+                nb_visible += store_mask(~_mm256_movemask_ps(outside), 8, visible + i);
+            }
+            return nb_visible;
+        }
+
+        // Centers and extents of 4 boxes, one component per register (cx, cy, cz, ex, ey, ez)
+        // Each box is read as two overlapping rows, [min.xyz, max.x] and [min.z, max.xyz], which are then transposed
+        static void load_centers_extents(const Aabb *boxes, __m128 out[6]) {
+            __m128 a0 = _mm_loadu_ps(&boxes[0].min.x), a1 = _mm_loadu_ps(&boxes[1].min.x),
+                   a2 = _mm_loadu_ps(&boxes[2].min.x), a3 = _mm_loadu_ps(&boxes[3].min.x);
+            __m128 b0 = _mm_loadu_ps(&boxes[0].min.z), b1 = _mm_loadu_ps(&boxes[1].min.z),
+                   b2 = _mm_loadu_ps(&boxes[2].min.z), b3 = _mm_loadu_ps(&boxes[3].min.z);
+            _MM_TRANSPOSE4_PS(a0, a1, a2, a3); // min.x, min.y, min.z, max.x
+            _MM_TRANSPOSE4_PS(b0, b1, b2, b3); // min.z, max.x, max.y, max.z
+
+            __m128 half = _mm_set1_ps(0.5f);
+            out[0] = _mm_mul_ps(_mm_add_ps(b1, a0), half), out[3] = _mm_mul_ps(_mm_sub_ps(b1, a0), half);
+            out[1] = _mm_mul_ps(_mm_add_ps(b2, a1), half), out[4] = _mm_mul_ps(_mm_sub_ps(b2, a1), half);
+            out[2] = _mm_mul_ps(_mm_add_ps(b3, a2), half), out[5] = _mm_mul_ps(_mm_sub_ps(b3, a2), half);
+        }
+#endif
+
+    protected:
+        glm::vec4 planes[6]; // Left, right, bottom, top, near, far
+};
+
+// Moves the visible items to the front, preserving their order, and returns how many there are
+template <typename T>
+std::size_t compact_visible(T *items, const std::uint8_t *visible, std::size_t n) {
+    std::size_t nb_visible = 0;
+    for (std::size_t i = 0; i < n; ++i)
+        if (visible[i])
+            items[nb_visible++] = items[i];
+    return nb_visible;
+}
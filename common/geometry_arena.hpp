@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <limits>
+#include <memory>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <glad/glad.h>
+
+#include "vertex_array.hpp"
+#include "buffer.hpp"
+
+// First-fit allocator of ranges in [0, capacity)
+// Free ranges are kept sorted by offset, and merged with their neighbours when released
+class RangeAllocator {
+    public:
+        static constexpr std::size_t invalid = -1;
+
+        RangeAllocator(std::size_t capacity = 0) {
+            grow(capacity);
+        }
+
+        // Returns the offset of the range (a multiple of alignment), or invalid if none is large enough
+        std::size_t allocate(std::size_t size, std::size_t alignment = 1) {
+            for (auto it = this->free_ranges.begin(); it != this->free_ranges.end(); ++it) {
+                auto [off, len] = *it;
+                std::size_t aligned = (off + alignment - 1) / alignment * alignment, pad = aligned - off;
+                if (len < pad + size)
+                    continue;
+
+                this->free_ranges.erase(it);
+                if (pad)
+                    this->free_ranges[off] = pad;
+                if (len > pad + size)
+                    this->free_ranges[aligned + size] = len - pad - size;
+                this->used += size;
+                return aligned;
+            }
+            return invalid;
+        }
+
+        void release(std::size_t off, std::size_t size) {
+            if (!size)
+                return;
+            this->used -= size;
+            auto next = this->free_ranges.lower_bound(off);
+            if (next != this->free_ranges.begin()) {
+                auto prev = std::prev(next);
+                if (prev->first + prev->second == off)
+                    off = prev->first, size += prev->second, this->free_ranges.erase(prev);
+            }
+            if ((next != this->free_ranges.end()) && (off + size == next->first))
+                size += next->second, this->free_ranges.erase(next);
+            this->free_ranges[off] = size;
+        }
+
+        // The added space is merged with a free range ending at the old capacity
+        void grow(std::size_t new_capacity) {
+            if (new_capacity <= this->capacity)
+                return;
+            std::size_t old_capacity = this->capacity;
+            this->capacity = new_capacity, this->used += new_capacity - old_capacity;
+            release(old_capacity, new_capacity - old_capacity);
+        }
+
+        inline std::size_t get_capacity()     const { return this->capacity; }
+        inline std::size_t get_used()         const { return this->used; }
+        inline std::size_t get_nb_fragments() const { return this->free_ranges.size(); }
+
+    protected:
+        std::map<std::size_t, std::size_t> free_ranges; // Offset -> size
+        std::size_t capacity = 0, used = 0;
+};
+
+// One vertex buffer and one element buffer shared by every mesh of a given vertex layout, behind a single VAO
+// Meshes draw their sub-range with a base vertex and a byte offset into the indices (glDrawElementsBaseVertex),
+// so switching between them needs no binding at all
+// The buffers double in size when full, which re-creates them: handles must not be cached outside the arena
+class GeometryArena {
+    public:
+        struct Allocation {
+            std::size_t vertex_off = RangeAllocator::invalid, vertex_size = 0; // In bytes
+            std::size_t index_off  = RangeAllocator::invalid, index_size  = 0;
+            GLint base_vertex = 0;
+
+            inline bool is_valid() const { return this->vertex_off != RangeAllocator::invalid; }
+        };
+
+        // set_layout specifies the vertex buffer on the VAO, whenever the former is (re)created
+        GeometryArena(std::size_t stride, std::function<void(const VertexArray<> &, const VertexBuffer<> &)> set_layout,
+                std::size_t vertex_capacity = 4 << 20, std::size_t index_capacity = 1 << 20):
+                stride(stride), set_layout(std::move(set_layout)),
+                vertex_alloc(vertex_capacity / stride * stride), index_alloc(index_capacity) {
+            this->vbo = std::make_unique<VertexBuffer<>>();
+            this->vbo->set_data(nullptr, this->vertex_alloc.get_capacity());
+            this->set_layout(this->vao, *this->vbo);
+            this->ebo = std::make_unique<ElementBuffer<>>();
+            this->ebo->set_data(nullptr, this->index_alloc.get_capacity());
+            this->vao.set_element_buffer(*this->ebo);
+        }
+
+        // Copies the data into the shared buffers, indices are relative to the first vertex of the allocation
+        // Leaves the arena VAO bound
+        Allocation allocate(const void *vertices, std::size_t nb_vertices, const void *indices, std::size_t indices_size) {
+            Allocation alloc;
+            alloc.vertex_size = nb_vertices * this->stride, alloc.index_size = indices_size;
+
+            // Vertex ranges are aligned to the stride so the base vertex is a whole number, indices to the largest index type
+            while ((alloc.vertex_off = this->vertex_alloc.allocate(alloc.vertex_size, this->stride)) == RangeAllocator::invalid)
+                grow(this->vbo, this->vertex_alloc, alloc.vertex_size + this->stride);
+            while ((alloc.index_off = this->index_alloc.allocate(alloc.index_size, sizeof(GLuint))) == RangeAllocator::invalid)
+                grow(this->ebo, this->index_alloc, alloc.index_size + sizeof(GLuint));
+            alloc.base_vertex = alloc.vertex_off / this->stride;
+
+            this->vbo->set_sub_data(vertices, alloc.vertex_size, alloc.vertex_off);
+            this->ebo->set_sub_data(indices, alloc.index_size, alloc.index_off);
+            this->vao.bind();
+            return alloc;
+        }
+
+        void release(Allocation &alloc) {
+            if (!alloc.is_valid())
+                return;
+            this->vertex_alloc.release(alloc.vertex_off, alloc.vertex_size);
+            this->index_alloc.release(alloc.index_off, alloc.index_size);
+            alloc = {};
+        }
+
+        void bind() const {
+            this->vao.bind();
+        }
+
+        inline GLuint                get_vao()          const { return this->vao.get_handle(); }
+        inline std::size_t           get_stride()       const { return this->stride; }
+        inline const RangeAllocator &get_vertex_alloc() const { return this->vertex_alloc; }
+        inline const RangeAllocator &get_index_alloc()  const { return this->index_alloc; }
+
+    private:
+        // Replaces the buffer by one at least twice as large, and copies the old contents over
+        template <typename B>
+        void grow(std::unique_ptr<B> &buf, RangeAllocator &alloc, std::size_t min_extra) {
+            std::size_t old_capacity = alloc.get_capacity(), new_capacity = std::max(2 * old_capacity, old_capacity + min_extra);
+            if (new_capacity > (std::size_t)std::numeric_limits<GLsizeiptr>::max())
+                throw std::runtime_error("Geometry arena is full");
+
+            auto new_buf = std::make_unique<B>();
+            new_buf->set_data(nullptr, new_capacity);
+            new_buf->copy_sub_data(*buf, old_capacity);
+            buf = std::move(new_buf);
+            alloc.grow(new_capacity);
+
+            if constexpr (std::is_same_v<B, VertexBuffer<>>)
+                this->set_layout(this->vao, *this->vbo);
+            else
+                this->vao.set_element_buffer(*this->ebo);
+        }
+
+    protected:
+        std::size_t stride;
+        std::function<void(const VertexArray<> &, const VertexBuffer<> &)> set_layout;
+        VertexArray<> vao;
+        std::unique_ptr<VertexBuffer<>>  vbo;
+        std::unique_ptr<ElementBuffer<>> ebo;
+        RangeAllocator vertex_alloc, index_alloc;
+};
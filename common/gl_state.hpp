@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+#include <glad/glad.h>
+
+#include "render_stats.hpp"
+#include "utils.hpp"
+
+// Process-wide mirror of the bindings made through the object wrappers, so that redundant binds are skipped,
+// and the way objects are edited on this context:
+//   - with Direct State Access (GL 4.5 or ARB_direct_state_access, and a 4.5 context requested), by name
+//   - otherwise bound to a dedicated edit point (see Buffer and Texture), through this cache
+// Code binding objects behind the wrappers' back must call invalidate()
+class GlState {
+    public:
+        static constexpr GLuint unknown = -1;
+
+        // Texture units at and past this one are not cached, the last one is reserved for edits
+        static constexpr GLuint nb_texture_units = 32;
+        static constexpr GLuint edit_texture_unit = nb_texture_units - 1;
+
+        // Called by Window::load_gl, with the version the context was requested with
+        static void init(int maj, int min) {
+            set_dsa(((maj > 4) || ((maj == 4) && (min >= 5))) && GLAD_GL_ARB_direct_state_access);
+            invalidate();
+        }
+
+        static void invalidate() {
+            for (auto &buffer: s_buffers)
+                buffer = unknown;
+            for (auto &unit: s_textures)
+                for (auto &texture: unit)
+                    texture = unknown;
+            s_vertex_array = s_active_unit = unknown;
+        }
+
+        static inline bool has_dsa() { return s_dsa; }
+
+        // Objects must not be created or edited in between
+        static inline void set_dsa(bool val) { s_dsa = val && GLAD_GL_ARB_direct_state_access; }
+
+        // Binds return whether a call was actually issued
+        static bool bind_buffer(GLenum target, GLuint handle) {
+            GLuint *cur = find_buffer(target);
+            if (cur && (*cur == handle))
+                return false;
+            glBindBuffer(target, handle);
+            if (cur)
+                *cur = handle;
+            ++RenderStats::get().nb_buffer_binds;
+            return true;
+        }
+
+        // Also binds the buffer to the generic binding point of target
+        static void bind_buffer_base(GLenum target, GLuint index, GLuint handle) {
+            glBindBufferBase(target, index, handle);
+            if (GLuint *cur = find_buffer(target))
+                *cur = handle;
+            ++RenderStats::get().nb_buffer_binds;
+        }
+
+        // The element buffer binding is part of the vertex array state
+        static bool bind_vertex_array(GLuint handle) {
+            if (s_vertex_array == handle)
+                return false;
+            glBindVertexArray(handle);
+            s_vertex_array = handle, *find_buffer(GL_ELEMENT_ARRAY_BUFFER) = unknown;
+            ++RenderStats::get().nb_vao_binds;
+            return true;
+        }
+
+        // Selecting a unit binds nothing, so it is not counted as a texture bind
+        static bool active_texture(GLuint unit) {
+            if (s_active_unit == unit)
+                return false;
+            glActiveTexture(GL_TEXTURE0 + unit);
+            s_active_unit = unit;
+            return true;
+        }
+
+        // Binds to the active unit
+        static bool bind_texture(GLenum target, GLuint handle) {
+            GLuint *cur = find_texture(s_active_unit, target);
+            if (cur && (*cur == handle))
+                return false;
+            glBindTexture(target, handle);
+            if (cur)
+                *cur = handle;
+            ++RenderStats::get().nb_texture_binds;
+            return true;
+        }
+
+        // Leaves the active unit untouched with DSA, and set to unit otherwise
+        static bool bind_texture_unit(GLuint unit, GLenum target, GLuint handle) {
+            if (!has_dsa()) {
+                active_texture(unit);
+                return bind_texture(target, handle);
+            }
+
+            GLuint *cur = find_texture(unit, target);
+            if (cur && (*cur == handle))
+                return false;
+            glBindTextureUnit(unit, handle);
+            if (!handle && (unit < nb_texture_units)) // Unbinds every target of the unit
+                for (auto &texture: s_textures[unit])
+                    texture = 0;
+            else if (cur)
+                *cur = handle;
+            ++RenderStats::get().nb_texture_binds;
+            return true;
+        }
+
+        // Points the units known to hold handle at new_handle instead (see Texture::recreate)
+        static void replace_texture(GLenum target, GLuint handle, GLuint new_handle) {
+            for (GLuint unit = 0; unit < nb_texture_units; ++unit)
+                if (GLuint *cur = find_texture(unit, target); cur && (*cur == handle))
+                    bind_texture_unit(unit, target, new_handle);
+        }
+
+        // Deleting an object unbinds it from the current context
+        static void forget_buffer(GLuint handle) {
+            for (auto &buffer: s_buffers)
+                if (buffer == handle)
+                    buffer = 0;
+        }
+
+        static void forget_vertex_array(GLuint handle) {
+            if (s_vertex_array == handle)
+                s_vertex_array = 0, *find_buffer(GL_ELEMENT_ARRAY_BUFFER) = unknown;
+        }
+
+        static void forget_texture(GLuint handle) {
+            for (auto &unit: s_textures)
+                for (auto &texture: unit)
+                    if (texture == handle)
+                        texture = 0;
+        }
+
+    private:
+        static constexpr GLenum buffer_targets[] = {
+            GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER,
+            GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_DRAW_INDIRECT_BUFFER,
+        };
+
+        static constexpr GLenum texture_targets[] = {
+            GL_TEXTURE_1D, GL_TEXTURE_2D, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP,
+        };
+
+        static GLuint *find_buffer(GLenum target) {
+            for (std::size_t i = 0; i < SIZEOF_ARRAY(buffer_targets); ++i)
+                if (buffer_targets[i] == target)
+                    return &s_buffers[i];
+            return nullptr;
+        }
+
+        static GLuint *find_texture(GLuint unit, GLenum target) {
+            if (unit >= nb_texture_units)
+                return nullptr;
+            for (std::size_t i = 0; i < SIZEOF_ARRAY(texture_targets); ++i)
+                if (texture_targets[i] == target)
+                    return &s_textures[unit][i];
+            return nullptr;
+        }
+
+        static inline bool s_dsa = false;
+        static inline GLuint s_buffers[SIZEOF_ARRAY(buffer_targets)];
+        static inline GLuint s_textures[nb_texture_units][SIZEOF_ARRAY(texture_targets)];
+        static inline GLuint s_vertex_array = unknown, s_active_unit = unknown;
+};
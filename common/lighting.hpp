@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+#include "utils.hpp"
+
+// C++ mirrors of the std140 lighting block declared by the lighting shaders:
+//   layout (std140) uniform lighting_block {
+//       pt_light_t  u_pt_light[5];
+//       dir_light_t u_dir_light;
+//       spotlight_t u_spotlight;
+//   };
+// std140 aligns vec3 and structs on 16 bytes but lets a scalar fill the tail of a vec3
+struct Std140Light {
+    alignas(16) glm::vec3 ambient;
+    alignas(16) glm::vec3 diffuse;
+    alignas(16) glm::vec3 specular;
+};
+ASSERT_SIZE(Std140Light, 48);
+
+struct Std140PointLight {
+    alignas(16) glm::vec3 position;
+    float constant, linear, quadratic;
+    alignas(16) Std140Light light;
+};
+ASSERT_SIZE(Std140PointLight, 80);
+
+struct Std140DirLight {
+    alignas(16) glm::vec3 direction;
+    alignas(16) Std140Light light;
+};
+ASSERT_SIZE(Std140DirLight, 64);
+
+struct Std140Spotlight {
+    alignas(16) glm::vec3 direction;
+    alignas(16) glm::vec3 position;
+    float inner_cutoff, outer_cutoff;
+    alignas(16) Std140Light light;
+};
+ASSERT_SIZE(Std140Spotlight, 96);
+
+struct LightingBlock {
+    static constexpr const char *name = "lighting_block";
+    static constexpr std::size_t nb_pt_lights = 5;
+
+    Std140PointLight pt_lights[nb_pt_lights];
+    Std140DirLight   dir_light;
+    Std140Spotlight  spotlight;
+};
+ASSERT_SIZE(LightingBlock, 560);
+static_assert(offsetof(Std140PointLight, constant)     == 12,  "Wrong offset in Std140PointLight");
+static_assert(offsetof(Std140Spotlight,  inner_cutoff) == 28,  "Wrong offset in Std140Spotlight");
+static_assert(offsetof(LightingBlock,    dir_light)    == 400, "Wrong offset in LightingBlock");
+static_assert(offsetof(LightingBlock,    spotlight)    == 464, "Wrong offset in LightingBlock");
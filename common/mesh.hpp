@@ -1,60 +1,307 @@
 #pragma once
 
+#include <stdexcept>
 #include <string>
 #include <tuple>
+#include <vector>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
 #include "vertex_array.hpp"
 #include "buffer.hpp"
+#include "geometry_arena.hpp"
+#include "multi_draw.hpp"
 #include "shader.hpp"
+#include "shader_program.hpp"
 #include "texture.hpp"
+#include "aabb.hpp"
+#include "render_stats.hpp"
+#include "profiler.hpp"
+#include "render_queue.hpp"
+#include "texture_cache.hpp"
+#include "vertex_packing.hpp"
 #include "utils.hpp"
 
 class Mesh {
     public:
+        // Meshes with up to this many vertices are drawn with 16-bit indices
+        static constexpr std::size_t max_short_vertices = 0x10000;
+
         struct Vertex {
             glm::vec3 position;
             glm::vec3 normal;
             glm::vec2 tex_coords;
         };
 
+        // GPU-side compact vertex: the position is snorm16 relative to the mesh bounds
+        // (decoded in the shader as u_pos_offset + position * u_pos_scale), the normal is snorm 10-10-10
+        // and the texture coordinates are halves
+        struct PackedVertex {
+            std::int16_t  position[4];
+            std::uint32_t normal;
+            std::uint16_t tex_coords[2];
+        };
+        ASSERT_SIZE(PackedVertex, 16);
+
+        enum class VertexFormat: std::uint8_t {
+            Float,
+            Packed,
+        };
+
+        // Whether the geometry stays in RAM after the upload, for CPU-side queries (picking, physics)
+        enum class Residency: std::uint8_t {
+            GpuOnly,
+            KeepCpuCopy,
+        };
+
         struct Texture {
-            Texture2d<> tex;
+            TextureCache::Handle tex;
+            TextureType type;
+            std::string path;
+        };
+
+        struct TextureRef {
             TextureType type;
             std::string path;
         };
 
-        Mesh(std::vector<Vertex> &vertices, std::vector<GLuint> &indices, std::vector<Texture> &textures):
-                vertices(vertices), indices(indices), textures(textures) {
-            bind_all(this->vao, this->vbo, this->ebo);
-            this->vbo.set_data(this->vertices.data(), this->vertices.size() * sizeof(Vertex));
-            this->vbo.set_layout({BufferElement::Float3, BufferElement::Float3, BufferElement::Float2});
-            this->ebo.set_data(this->indices.data(), this->indices.size() * sizeof(GLuint));
+        // CPU-side geometry, as extracted by the importer or read back from the mesh cache
+        struct Data {
+            std::vector<Vertex>     vertices;
+            std::vector<GLuint>     indices;
+            std::vector<TextureRef> textures;
+            Aabb                    bounds;
+        };
+
+        Mesh(const std::vector<Vertex> &vertices, const std::vector<GLuint> &indices, std::vector<Texture> &textures,
+                VertexFormat format = VertexFormat::Float, Residency residency = Residency::GpuOnly):
+                Mesh(vertices.data(), vertices.size(), indices.data(), indices.size(), textures,
+                    Aabb::from_points(vertices.data(), vertices.size(), sizeof(Vertex)), format, residency) { }
+
+        // Uploads straight from caller-owned memory (eg. a mapped cache file), which is only copied if asked to
+        Mesh(const Vertex *vertices, std::size_t nb_vertices, const GLuint *indices, std::size_t nb_indices,
+                std::vector<Texture> &textures, const Aabb &bounds, VertexFormat format = VertexFormat::Float,
+                Residency residency = Residency::GpuOnly):
+                textures(textures), nb_indices(nb_indices), bounds(bounds), format(format) {
+            upload(vertices, nb_vertices, indices, nb_indices);
+            if (residency == Residency::KeepCpuCopy) {
+                this->vertices.assign(vertices, vertices + nb_vertices);
+                this->indices.assign(indices, indices + nb_indices);
+            }
+        }
+
+        // Meshes own their range of the arena, so they can only be moved
+        Mesh(const Mesh &) = delete;
+        Mesh &operator =(const Mesh &) = delete;
+
+        Mesh(Mesh &&other) noexcept: vertices(std::move(other.vertices)), indices(std::move(other.indices)),
+                textures(std::move(other.textures)), nb_indices(other.nb_indices), nb_vertices(other.nb_vertices),
+                index_type(other.index_type), bounds(other.bounds), format(other.format), alloc(other.alloc),
+                arenas_id(other.arenas_id) {
+            other.alloc = {};
+        }
+
+        Mesh &operator =(Mesh &&other) noexcept {
+            if (this != &other) {
+                release();
+                this->vertices   = std::move(other.vertices);
+                this->indices    = std::move(other.indices);
+                this->textures   = std::move(other.textures);
+                this->nb_indices = other.nb_indices, this->nb_vertices = other.nb_vertices;
+                this->index_type = other.index_type, this->bounds      = other.bounds;
+                this->format     = other.format,     this->alloc       = other.alloc;
+                this->arenas_id  = other.arenas_id;
+                other.alloc = {};
+            }
+            return *this;
+        }
+
+        ~Mesh() {
+            release();
         }
 
         void draw(ShaderProgram &program) {
-            std::size_t i = 0, diff_cnt = 0, spec_cnt = 0;
-            for (auto &[texture, type, path]: this->textures) {
-                texture.active(i++);
-                std::string id = "";
-                if      (type == TextureType::Diffuse)
-                    id = "tex_diff_" + std::to_string(diff_cnt++);
-                else if (type == TextureType::Specular)
-                    id = "tex_spec_" + std::to_string(spec_cnt++);
-                program.set_value(("material." + id).c_str(), i);
-                texture.bind();
+            PROFILE_ZONE("Mesh::draw");
+            set_uniforms(program);
+            bind_textures();
+            get_arena(this->format).bind();
+            draw_elements(GL_TRIANGLES, this->nb_indices, this->index_type, (const void *)this->alloc.index_off, 1,
+                this->alloc.base_vertex);
+        }
+
+        void bind_textures() const {
+            GLuint i = 0;
+            for (auto &texture: this->textures)
+                texture.tex->bind_unit(i++);
+        }
+
+        // Meshes in one batch must share their vertex format, index type and textures
+        void add_to(MultiDrawBatch &batch) const {
+            batch.push(this->nb_indices, this->index_type, this->alloc.index_off, this->alloc.base_vertex);
+        }
+
+        // Texture i is bound to unit i, so a render queue can share bindings between meshes
+        DrawItem get_draw_item(ShaderProgram &program) const {
+            DrawItem item = { &program, get_arena(this->format).get_vao() };
+            for (auto &texture: this->textures)
+                item.textures.push(texture.tex->get_handle());
+            item.count       = this->nb_indices;
+            item.index_type  = this->index_type;
+            item.first       = this->alloc.index_off;
+            item.base_vertex = this->alloc.base_vertex;
+            return item;
+        }
+
+        void submit(RenderQueue &queue, ShaderProgram &program, float depth = 0.0f) const {
+            DrawItem item = get_draw_item(program);
+            item.set_uniforms = [this](ShaderProgram &program) { set_uniforms(program); };
+            queue.submit(std::move(item), depth);
+        }
+
+        // Points the material samplers at the units the textures are bound to, and sets the position decoding
+        // Float meshes rely on the shader defaults (0 and 1), and only reset the decoding in programs declaring it,
+        // in case a packed mesh was drawn with the same program before
+        // Repeated values are elided by the program, so this is cheap when meshes share a layout
+        void set_uniforms(ShaderProgram &program) const {
+            static constexpr UniformId diff_id = "material.tex_diff_"_u, spec_id = "material.tex_spec_"_u;
+            static constexpr UniformId offset_id = "u_pos_offset"_u, scale_id = "u_pos_scale"_u;
+
+            if (this->format == VertexFormat::Packed) {
+                program.set_value(offset_id, this->bounds.get_center());
+                program.set_value(scale_id,  get_pos_scale());
+            } else if (GLint offset_loc = program.get_optional_uniform_loc(offset_id); offset_loc >= 0) {
+                program.set_value(offset_loc, glm::vec3(0.0f));
+                program.set_value(program.get_optional_uniform_loc(scale_id), glm::vec3(1.0f));
+            }
+
+            GLint i = 0, diff_cnt = 0, spec_cnt = 0;
+            for (auto &texture: this->textures) {
+                if      (texture.type == TextureType::Diffuse)
+                    program.set_value(diff_id.append(diff_cnt++), i);
+                else if (texture.type == TextureType::Specular)
+                    program.set_value(spec_id.append(spec_cnt++), i);
+                ++i;
             }
-            this->vao.bind();
-            glDrawElements(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0);
         }
 
-    protected:
-        VertexArray<>   vao;
-        VertexBuffer<>  vbo;
-        ElementBuffer<> ebo;
+        // Object-space bounds of the vertices
+        inline const Aabb &get_bounds()      const { return this->bounds; }
+        inline std::size_t get_nb_indices() const { return this->nb_indices; }
+        inline std::size_t get_nb_vertices()  const { return this->nb_vertices; }
+        inline GLenum      get_index_type()   const { return this->index_type; }
+        inline VertexFormat get_format()      const { return this->format; }
+
+        inline const std::vector<Texture> &get_textures() const { return this->textures; }
+
+        // CPU copy of the geometry, empty unless the mesh was created with Residency::KeepCpuCopy
+        inline const std::vector<Vertex> &get_vertices() const { return this->vertices; }
+        inline const std::vector<GLuint> &get_indices()  const { return this->indices; }
+        inline bool is_cpu_resident()                    const { return !this->indices.empty(); }
+
+        void release_cpu_copy() {
+            this->vertices = {};
+            this->indices  = {};
+        }
+
+        // Size of the vertex and index data in video memory
+        inline std::size_t get_gpu_size() const {
+            return this->nb_vertices * ((this->format == VertexFormat::Packed) ? sizeof(PackedVertex) : sizeof(Vertex))
+                + this->nb_indices * ((this->index_type == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint));
+        }
+
+        static inline GLenum get_index_type(std::size_t nb_vertices) {
+            return (nb_vertices <= max_short_vertices) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        }
+
+        // Owner of the arenas, created once the context is loaded and destroyed before the window
+        // Meshes outliving it drop their allocation along with the arenas, it is never released into a later owner
+        class Arenas {
+            public:
+                Arenas():
+                    packed_arena(sizeof(PackedVertex), [](const VertexArray<> &vao, const VertexBuffer<> &vbo) {
+                        vao.set_layout({{BufferElement::Short4, true}, {BufferElement::Packed4, true}, BufferElement::Half2}, vbo);
+                    }),
+                    float_arena(sizeof(Vertex), [](const VertexArray<> &vao, const VertexBuffer<> &vbo) {
+                        vao.set_layout({BufferElement::Float3, BufferElement::Float3, BufferElement::Float2}, vbo);
+                    }) {
+                    if (s_arenas)
+                        throw std::runtime_error("Mesh arenas created twice");
+                    s_arenas = this, ++s_arenas_id;
+                }
+
+                ~Arenas() {
+                    s_arenas = nullptr;
+                }
+
+                Arenas(const Arenas &) = delete;
+                Arenas &operator =(const Arenas &) = delete;
 
+            private:
+                friend class Mesh;
+                GeometryArena packed_arena, float_arena;
+        };
+
+        // Geometry of all meshes with the same vertex format
+        static GeometryArena &get_arena(VertexFormat format) {
+            if (!s_arenas)
+                throw std::runtime_error("Mesh arenas used outside of the lifetime of their owner");
+            return (format == VertexFormat::Packed) ? s_arenas->packed_arena : s_arenas->float_arena;
+        }
+
+    private:
+        static inline Arenas *s_arenas = nullptr;
+        static inline unsigned s_arenas_id = 0;
+
+        void release() {
+            if (s_arenas && (this->arenas_id == s_arenas_id))
+                get_arena(this->format).release(this->alloc);
+        }
+
+        void upload(const Vertex *vertices, std::size_t nb_vertices, const GLuint *indices, std::size_t nb_indices) {
+            // Indices are kept 32-bit on the CPU, and narrowed for the upload when they fit
+            this->nb_vertices = nb_vertices;
+            this->index_type  = get_index_type(nb_vertices);
+            std::vector<GLushort> short_indices;
+            const void *index_data = indices;
+            std::size_t index_size = nb_indices * sizeof(GLuint);
+            if (this->index_type == GL_UNSIGNED_SHORT) {
+                short_indices.assign(indices, indices + nb_indices);
+                index_data = short_indices.data(), index_size = nb_indices * sizeof(GLushort);
+            }
+
+            auto &arena = get_arena(this->format);
+            this->arenas_id = s_arenas_id;
+            if (this->format == VertexFormat::Packed) {
+                std::vector<PackedVertex> packed(nb_vertices);
+                glm::vec3 offset = this->bounds.get_center(), inv_scale = 1.0f / get_pos_scale();
+                for (std::size_t i = 0; i < nb_vertices; ++i) {
+                    glm::vec3 pos = (vertices[i].position - offset) * inv_scale;
+                    const glm::vec3 &n = vertices[i].normal;
+                    packed[i] = {
+                        { pack_snorm16(pos.x), pack_snorm16(pos.y), pack_snorm16(pos.z), 0 },
+                        pack_snorm_2_10_10_10(n.x, n.y, n.z),
+                        { pack_half(vertices[i].tex_coords.x), pack_half(vertices[i].tex_coords.y) },
+                    };
+                }
+                this->alloc = arena.allocate(packed.data(), nb_vertices, index_data, index_size);
+            } else {
+                this->alloc = arena.allocate(vertices, nb_vertices, index_data, index_size);
+            }
+        }
+
+        // Half the bounds size, a flat axis is given a non-zero scale so the positions still divide by it
+        inline glm::vec3 get_pos_scale() const {
+            return glm::max(this->bounds.get_extent(), glm::vec3(1e-6f));
+        }
+
+    protected:
         std::vector<Vertex>  vertices;
         std::vector<GLuint>  indices;
         std::vector<Texture> textures;
+        std::size_t          nb_indices, nb_vertices = 0;
+        GLenum               index_type = GL_UNSIGNED_INT;
+        Aabb                 bounds;
+        VertexFormat         format = VertexFormat::Float;
+        GeometryArena::Allocation alloc;
+        unsigned             arenas_id = 0; // Owner the allocation was made from
 };
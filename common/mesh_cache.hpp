@@ -0,0 +1,268 @@
+#pragma once
+
+#include <cstdint>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <optional>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mesh.hpp"
+#include "utils.hpp"
+
+// On-disk cache of flattened Model geometry, so warm starts can skip Assimp entirely
+// Layout (all sections 16-byte aligned):
+//   Header, source path
+//   per mesh: MeshHeader, Aabb, TextureEntry + path (* nb_textures), Mesh::Vertex[nb_vertices], GLuint[nb_indices]
+class MeshCache {
+    public:
+        static constexpr std::uint32_t magic   = 0x4843534d; // "MSCH"
+        static constexpr std::uint32_t version = 4;
+
+        struct Header {
+            std::uint32_t magic, version;
+            std::int64_t  mtime;
+            std::uint32_t flags, nb_meshes;
+            std::uint32_t path_len, vertex_size;
+            std::uint32_t options, reserved;
+        };
+        ASSERT_SIZE(Header, 40);
+
+        struct MeshHeader {
+            std::uint32_t nb_vertices, nb_indices, nb_textures, reserved;
+        };
+        ASSERT_SIZE(MeshHeader, 16);
+
+        struct TextureEntry {
+            std::uint32_t type, path_len;
+        };
+        ASSERT_SIZE(TextureEntry, 8);
+
+        struct MeshView {
+            const Mesh::Vertex *vertices;
+            std::size_t         nb_vertices;
+            const GLuint       *indices;
+            std::size_t         nb_indices;
+            std::vector<Mesh::TextureRef> textures;
+            Aabb                bounds;
+        };
+
+        // Read-only mapping of a validated cache file
+        class Mapping {
+            public:
+                Mapping(void *addr, std::size_t size): addr(addr), size(size) { }
+                Mapping(const Mapping &) = delete;
+                Mapping(Mapping &&other): addr(other.addr), size(other.size), meshes(std::move(other.meshes)) {
+                    other.addr = nullptr;
+                }
+
+                ~Mapping() {
+                    if (this->addr)
+                        munmap(this->addr, this->size);
+                }
+
+                inline const std::vector<MeshView> &get_meshes() const { return this->meshes; }
+
+            protected:
+                friend class MeshCache;
+
+                void *addr;
+                std::size_t size;
+                std::vector<MeshView> meshes;
+        };
+
+        // Disabled unless a directory is given, here or through LOGL_MESH_CACHE
+        static void set_directory(const std::string &dir) { s_directory = dir; }
+        static inline const std::string &get_directory()  { return s_directory; }
+        static inline bool is_enabled()                   { return !s_directory.empty(); }
+
+        // For applications opting in: LOGL_MESH_CACHE still wins when set, an empty value disabling the cache
+        static void set_default_directory(const std::string &dir) {
+            if (!std::getenv(env_name))
+                s_directory = dir;
+        }
+
+        // options are the post-import processing steps applied by the caller, opaque to the cache
+        static std::string get_cache_path(const std::string &path, std::uint32_t flags, std::uint32_t options = 0) {
+            char name[0x30];
+            std::snprintf(name, sizeof(name), "%016" PRIx64 "-%08" PRIx32 "-%" PRIx32 ".mesh", fnv1a_64(path), flags, options);
+            return (std::filesystem::path(s_directory) / name).string();
+        }
+
+        static std::optional<Mapping> load(const std::string &path, std::uint32_t flags, std::uint32_t options = 0) {
+            if (!is_enabled())
+                return std::nullopt;
+
+            std::int64_t mtime;
+            if (!get_mtime(path, mtime))
+                return std::nullopt;
+
+            int fd = open(get_cache_path(path, flags, options).c_str(), O_RDONLY);
+            if (fd < 0)
+                return std::nullopt;
+
+            struct stat st;
+            void *addr = MAP_FAILED;
+            if (!fstat(fd, &st) && (std::size_t)st.st_size >= sizeof(Header))
+                addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+            close(fd);
+            if (addr == MAP_FAILED)
+                return std::nullopt;
+
+            Mapping mapping{addr, (std::size_t)st.st_size};
+            if (!parse(mapping, path, flags, options, mtime))
+                return std::nullopt;
+            return mapping;
+        }
+
+        static bool store(const std::string &path, std::uint32_t flags, const std::vector<Mesh::Data> &meshes,
+                std::uint32_t options = 0) {
+            std::int64_t mtime;
+            if (!is_enabled() || !get_mtime(path, mtime))
+                return false;
+
+            std::error_code ec;
+            std::filesystem::create_directories(s_directory, ec);
+
+            // Write to a temporary file first so a concurrent reader never sees a partial cache
+            std::string cache_path = get_cache_path(path, flags, options), tmp_path = cache_path + ".tmp";
+            std::ofstream fp{tmp_path, std::ios::out | std::ios::binary | std::ios::trunc};
+            if (!fp.is_open())
+                return false;
+
+            Header header = { magic, version, mtime, flags, (std::uint32_t)meshes.size(),
+                (std::uint32_t)path.size(), sizeof(Mesh::Vertex), options, 0 };
+            write(fp, &header, sizeof(header));
+            write(fp, path.data(), path.size());
+            pad(fp);
+
+            for (auto &mesh: meshes) {
+                MeshHeader mesh_header = { (std::uint32_t)mesh.vertices.size(), (std::uint32_t)mesh.indices.size(),
+                    (std::uint32_t)mesh.textures.size(), 0 };
+                write(fp, &mesh_header, sizeof(mesh_header));
+                write(fp, &mesh.bounds, sizeof(Aabb));
+                for (auto &[type, tex_path]: mesh.textures) {
+                    TextureEntry entry = { (std::uint32_t)type, (std::uint32_t)tex_path.size() };
+                    write(fp, &entry, sizeof(entry));
+                    write(fp, tex_path.data(), tex_path.size());
+                }
+                pad(fp);
+                write(fp, mesh.vertices.data(), mesh.vertices.size() * sizeof(Mesh::Vertex));
+                pad(fp);
+                write(fp, mesh.indices.data(), mesh.indices.size() * sizeof(GLuint));
+                pad(fp);
+            }
+
+            fp.close();
+            if (fp.fail()) {
+                std::filesystem::remove(tmp_path, ec);
+                return false;
+            }
+            std::filesystem::rename(tmp_path, cache_path, ec);
+            return !ec;
+        }
+
+        static void remove(const std::string &path, std::uint32_t flags, std::uint32_t options = 0) {
+            if (!is_enabled())
+                return;
+            std::error_code ec;
+            std::filesystem::remove(get_cache_path(path, flags, options), ec);
+        }
+
+    private:
+        static constexpr const char *env_name = "LOGL_MESH_CACHE";
+        static constexpr std::size_t alignment = 0x10;
+
+        static constexpr std::size_t align_up(std::size_t off) {
+            return (off + alignment - 1) & ~(alignment - 1);
+        }
+
+        static bool get_mtime(const std::string &path, std::int64_t &mtime) {
+            struct stat st;
+            if (stat(path.c_str(), &st))
+                return false;
+            mtime = (std::int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+            return true;
+        }
+
+        static void write(std::ofstream &fp, const void *data, std::size_t size) {
+            fp.write((const char *)data, size);
+        }
+
+        static void pad(std::ofstream &fp) {
+            static constexpr char zeroes[alignment] = {};
+            std::size_t off = fp.tellp();
+            fp.write(zeroes, align_up(off) - off);
+        }
+
+        static bool parse(Mapping &mapping, const std::string &path, std::uint32_t flags, std::uint32_t options, std::int64_t mtime) {
+            auto *base = (const std::uint8_t *)mapping.addr;
+            std::size_t off = 0, size = mapping.size;
+
+            auto take = [&](std::size_t len) -> const std::uint8_t * {
+                if ((off > size) || (len > size - off))
+                    return nullptr;
+                auto *ptr = base + off;
+                off += len;
+                return ptr;
+            };
+
+            auto *header = (const Header *)take(sizeof(Header));
+            if (!header || (header->magic != magic) || (header->version != version) || (header->mtime != mtime)
+                    || (header->flags != flags) || (header->options != options) || (header->vertex_size != sizeof(Mesh::Vertex)))
+                return false;
+
+            auto *src_path = (const char *)take(header->path_len);
+            if (!src_path || (std::string_view(src_path, header->path_len) != path))
+                return false;
+            off = align_up(off);
+
+            mapping.meshes.reserve(header->nb_meshes);
+            for (std::size_t i = 0; i < header->nb_meshes; ++i) {
+                auto *mesh_header = (const MeshHeader *)take(sizeof(MeshHeader));
+                auto *bounds      = (const Aabb *)take(sizeof(Aabb));
+                if (!mesh_header || !bounds)
+                    return false;
+
+                MeshView view;
+                view.bounds = *bounds;
+                view.textures.reserve(mesh_header->nb_textures);
+                for (std::size_t j = 0; j < mesh_header->nb_textures; ++j) {
+                    auto *entry = (const TextureEntry *)take(sizeof(TextureEntry));
+                    const char *tex_path = entry ? (const char *)take(entry->path_len) : nullptr;
+                    if (!tex_path)
+                        return false;
+                    view.textures.push_back({(TextureType)entry->type, std::string(tex_path, entry->path_len)});
+                }
+                off = align_up(off);
+
+                view.nb_vertices = mesh_header->nb_vertices;
+                view.vertices    = (const Mesh::Vertex *)take(view.nb_vertices * sizeof(Mesh::Vertex));
+                off = align_up(off);
+                view.nb_indices  = mesh_header->nb_indices;
+                view.indices     = (const GLuint *)take(view.nb_indices * sizeof(GLuint));
+                off = align_up(off);
+                if (!view.vertices || !view.indices)
+                    return false;
+
+                mapping.meshes.push_back(std::move(view));
+            }
+
+            return true;
+        }
+
+    protected:
+        static inline std::string s_directory = [] {
+            const char *env = std::getenv(env_name);
+            return std::string(env ? env : "");
+        }();
+};
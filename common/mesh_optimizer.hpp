@@ -0,0 +1,339 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "utils.hpp"
+
+// Index/vertex reordering for triangle lists, run once at import time:
+// - vertex cache: Forsyth's greedy ordering, triangles are picked by the score of their vertices
+//   in a simulated LRU cache, so consecutive triangles share transformed vertices
+// - overdraw: the cache-ordered list is split into clusters at cache restarts, and clusters facing
+//   away from the mesh center (which tend to occlude the others) are drawn first (after Sander et al.)
+// - vertex fetch: vertices are renumbered in order of first use, so fetches walk the buffer linearly
+// Vertices only need a glm::vec3 position member
+// Welding and splitting prepare the index data: duplicate vertices are merged, and meshes too large
+// for 16-bit indices can be cut into chunks that fit
+class MeshOptimizer {
+    public:
+        static constexpr std::size_t default_cache_size = 16;
+
+        template <typename V>
+        struct Chunk {
+            std::vector<V>      vertices;
+            std::vector<GLuint> indices;
+        };
+
+        struct CacheStats {
+            float acmr; // Average cache miss ratio: transformed vertices per triangle, 0.5 to 3 (lower is better)
+            float atvr; // Average transformed vertex ratio: transformed vertices per vertex, 1 is optimal
+        };
+
+        struct Stats {
+            CacheStats before, after;
+        };
+
+        // Simulates a FIFO post-transform cache, as found on most hardware
+        static CacheStats analyze_vertex_cache(const GLuint *indices, std::size_t nb_indices, std::size_t nb_vertices,
+                std::size_t cache_size = default_cache_size) {
+            if (!nb_indices || !nb_vertices)
+                return { 0.0f, 0.0f };
+
+            // Timestamps of when each vertex entered the cache, a vertex is cached if it entered less than cache_size misses ago
+            std::vector<std::size_t> timestamps(nb_vertices, 0);
+            std::size_t time = cache_size + 1, nb_misses = 0;
+            for (std::size_t i = 0; i < nb_indices; ++i) {
+                GLuint idx = indices[i];
+                if (time - timestamps[idx] > cache_size)
+                    timestamps[idx] = time++, ++nb_misses;
+            }
+            return { (float)nb_misses / (nb_indices / 3), (float)nb_misses / nb_vertices };
+        }
+
+        static void optimize_vertex_cache(GLuint *indices, std::size_t nb_indices, std::size_t nb_vertices) {
+            std::size_t nb_triangles = nb_indices / 3;
+            if (!nb_triangles)
+                return;
+
+            // Vertex -> triangles adjacency, in a flattened array
+            std::vector<std::uint32_t> valence(nb_vertices, 0), offsets(nb_vertices + 1, 0), adjacency(nb_indices);
+            for (std::size_t i = 0; i < nb_indices; ++i)
+                ++valence[indices[i]];
+            for (std::size_t i = 0; i < nb_vertices; ++i)
+                offsets[i + 1] = offsets[i] + valence[i];
+            {
+                std::vector<std::uint32_t> fill(offsets.begin(), offsets.end() - 1);
+                for (std::size_t i = 0; i < nb_indices; ++i)
+                    adjacency[fill[indices[i]]++] = i / 3;
+            }
+
+            // valence now counts the triangles not yet emitted
+            std::vector<float> vertex_scores(nb_vertices), triangle_scores(nb_triangles);
+            std::vector<std::int32_t> cache_pos(nb_vertices, -1);
+            for (std::size_t i = 0; i < nb_vertices; ++i)
+                vertex_scores[i] = get_vertex_score(-1, valence[i]);
+            for (std::size_t i = 0; i < nb_triangles; ++i)
+                triangle_scores[i] = vertex_scores[indices[3 * i]] + vertex_scores[indices[3 * i + 1]] + vertex_scores[indices[3 * i + 2]];
+
+            std::vector<std::uint8_t> emitted(nb_triangles, 0);
+            std::vector<GLuint> result;
+            result.reserve(nb_indices);
+
+            GLuint cache[forsyth_cache_size + 3];
+            std::size_t cache_count = 0, next_unemitted = 0;
+            std::int64_t best = std::max_element(triangle_scores.begin(), triangle_scores.end()) - triangle_scores.begin();
+
+            while (best >= 0) {
+                emitted[best] = 1;
+                const GLuint *tri = indices + 3 * best;
+                result.insert(result.end(), tri, tri + 3);
+
+                // Move the triangle vertices to the front of the LRU cache
+                GLuint new_cache[forsyth_cache_size + 3];
+                std::size_t new_count = 0;
+                for (std::size_t i = 0; i < 3; ++i)
+                    if (std::find(new_cache, new_cache + new_count, tri[i]) == new_cache + new_count)
+                        new_cache[new_count++] = tri[i];
+                for (std::size_t i = 0; i < cache_count; ++i)
+                    if ((cache[i] != tri[0]) && (cache[i] != tri[1]) && (cache[i] != tri[2]))
+                        new_cache[new_count++] = cache[i];
+
+                // Remove the emitted triangle from the adjacency of its vertices
+                for (std::size_t i = 0; i < 3; ++i) {
+                    GLuint v = tri[i];
+                    auto *begin = adjacency.data() + offsets[v], *end = begin + valence[v];
+                    std::swap(*std::find(begin, end, (std::uint32_t)best), *(end - 1));
+                    --valence[v];
+                }
+
+                // Update the scores of every vertex that was or is in the cache, and of their triangles
+                for (std::size_t i = 0; i < new_count; ++i) {
+                    GLuint v = new_cache[i];
+                    cache_pos[v] = (i < forsyth_cache_size) ? i : -1;
+                    vertex_scores[v] = get_vertex_score(cache_pos[v], valence[v]);
+                }
+                cache_count = std::min(new_count, forsyth_cache_size);
+                std::copy(new_cache, new_cache + cache_count, cache);
+
+                best = -1;
+                float best_score = -1.0f;
+                for (std::size_t i = 0; i < new_count; ++i) {
+                    GLuint v = new_cache[i];
+                    for (std::uint32_t j = 0; j < valence[v]; ++j) {
+                        std::uint32_t t = adjacency[offsets[v] + j];
+                        float score = triangle_scores[t] = vertex_scores[indices[3 * t]]
+                            + vertex_scores[indices[3 * t + 1]] + vertex_scores[indices[3 * t + 2]];
+                        if (score > best_score)
+                            best_score = score, best = t;
+                    }
+                }
+
+                // Nothing left around the cache, restart from the first remaining triangle
+                if (best < 0) {
+                    while ((next_unemitted < nb_triangles) && emitted[next_unemitted])
+                        ++next_unemitted;
+                    best = (next_unemitted < nb_triangles) ? (std::int64_t)next_unemitted : -1;
+                }
+            }
+
+            std::copy(result.begin(), result.end(), indices);
+        }
+
+        // Reorders cache-optimized triangles to reduce overdraw, keeping the cache miss ratio within
+        // threshold times its current value (the order is left untouched if that can't be met)
+        template <typename V>
+        static void optimize_overdraw(GLuint *indices, std::size_t nb_indices, const V *vertices, std::size_t nb_vertices,
+                float threshold = 1.05f, std::size_t cache_size = default_cache_size) {
+            std::size_t nb_triangles = nb_indices / 3;
+            if (nb_triangles < 2)
+                return;
+
+            // Clusters start where the cache simulation misses on all 3 vertices
+            std::vector<std::size_t> clusters;
+            {
+                std::vector<std::size_t> timestamps(nb_vertices, 0);
+                std::size_t time = cache_size + 1;
+                for (std::size_t i = 0; i < nb_triangles; ++i) {
+                    std::size_t nb_misses = 0;
+                    for (std::size_t j = 0; j < 3; ++j) {
+                        GLuint idx = indices[3 * i + j];
+                        if (time - timestamps[idx] > cache_size)
+                            timestamps[idx] = time++, ++nb_misses;
+                    }
+                    if (!i || (nb_misses == 3))
+                        clusters.push_back(i);
+                }
+            }
+            if (clusters.size() < 2)
+                return;
+            clusters.push_back(nb_triangles);
+
+            // Area-weighted centroid and normal of each cluster, and of the whole mesh
+            std::size_t nb_clusters = clusters.size() - 1;
+            std::vector<glm::vec3> centroids(nb_clusters), normals(nb_clusters);
+            glm::vec3 mesh_centroid(0.0f);
+            float mesh_area = 0.0f;
+            for (std::size_t c = 0; c < nb_clusters; ++c) {
+                glm::vec3 centroid(0.0f), normal(0.0f);
+                float area = 0.0f;
+                for (std::size_t i = clusters[c]; i < clusters[c + 1]; ++i) {
+                    const glm::vec3 &p0 = vertices[indices[3 * i]].position, &p1 = vertices[indices[3 * i + 1]].position,
+                                    &p2 = vertices[indices[3 * i + 2]].position;
+                    glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+                    float a = glm::length(n);
+                    centroid += (p0 + p1 + p2) * (a / 3.0f), normal += n, area += a;
+                }
+                centroids[c] = (area > 0.0f) ? centroid / area : centroid;
+                normals[c]   = normal;
+                mesh_centroid += centroid, mesh_area += area;
+            }
+            if (mesh_area > 0.0f)
+                mesh_centroid /= mesh_area;
+
+            // Clusters pointing away from the center are likely on the outside, and occlude the rest
+            std::vector<float> sort_keys(nb_clusters);
+            for (std::size_t c = 0; c < nb_clusters; ++c) {
+                float len = glm::length(normals[c]);
+                sort_keys[c] = (len > 0.0f) ? glm::dot(centroids[c] - mesh_centroid, normals[c] / len) : 0.0f;
+            }
+            std::vector<std::size_t> order(nb_clusters);
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return sort_keys[a] > sort_keys[b]; });
+
+            std::vector<GLuint> result;
+            result.reserve(nb_indices);
+            for (std::size_t c: order)
+                result.insert(result.end(), indices + 3 * clusters[c], indices + 3 * clusters[c + 1]);
+
+            float acmr_before = analyze_vertex_cache(indices, nb_indices, nb_vertices, cache_size).acmr,
+                  acmr_after  = analyze_vertex_cache(result.data(), nb_indices, nb_vertices, cache_size).acmr;
+            if (acmr_after <= acmr_before * threshold)
+                std::copy(result.begin(), result.end(), indices);
+        }
+
+        // Renumbers vertices by first use and drops the unreferenced ones, returns the new vertex count
+        template <typename V>
+        static std::size_t optimize_vertex_fetch(GLuint *indices, std::size_t nb_indices, V *vertices, std::size_t nb_vertices) {
+            std::vector<GLuint> remap(nb_vertices, (GLuint)-1);
+            std::vector<V> reordered;
+            reordered.reserve(nb_vertices);
+            for (std::size_t i = 0; i < nb_indices; ++i) {
+                GLuint &new_idx = remap[indices[i]];
+                if (new_idx == (GLuint)-1)
+                    new_idx = reordered.size(), reordered.push_back(vertices[indices[i]]);
+                indices[i] = new_idx;
+            }
+            std::copy(reordered.begin(), reordered.end(), vertices);
+            return reordered.size();
+        }
+
+        // Merges vertices with identical bytes and compacts the array, returns the new vertex count
+        // Vertices are hashed and compared as raw memory, so V must not have padding
+        template <typename V>
+        static std::size_t weld_vertices(GLuint *indices, std::size_t nb_indices, V *vertices, std::size_t nb_vertices) {
+            static_assert(std::is_trivially_copyable_v<V>, "Vertices must be trivially copyable");
+
+            // Open addressing with linear probing, at most half full
+            std::size_t table_size = 1;
+            while (table_size < 2 * nb_vertices)
+                table_size <<= 1;
+            std::vector<GLuint> table(table_size, (GLuint)-1), remap(nb_vertices);
+
+            std::size_t nb_unique = 0;
+            for (std::size_t i = 0; i < nb_vertices; ++i) {
+                std::size_t slot = fnv1a_64(std::string_view((const char *)&vertices[i], sizeof(V))) & (table_size - 1);
+                while (true) {
+                    GLuint entry = table[slot];
+                    if (entry == (GLuint)-1) {
+                        vertices[nb_unique] = vertices[i];
+                        table[slot] = remap[i] = nb_unique++;
+                        break;
+                    }
+                    if (!std::memcmp(&vertices[entry], &vertices[i], sizeof(V))) {
+                        remap[i] = entry;
+                        break;
+                    }
+                    slot = (slot + 1) & (table_size - 1);
+                }
+            }
+
+            for (std::size_t i = 0; i < nb_indices; ++i)
+                indices[i] = remap[indices[i]];
+            return nb_unique;
+        }
+
+        // Cuts the triangle list, in order, into chunks referencing at most max_vertices vertices each
+        // Vertices used by several chunks are duplicated in each of them
+        template <typename V>
+        static std::vector<Chunk<V>> split(const GLuint *indices, std::size_t nb_indices, const V *vertices, std::size_t nb_vertices,
+                std::size_t max_vertices) {
+            std::vector<Chunk<V>> chunks(1);
+            std::vector<GLuint> remap(nb_vertices, (GLuint)-1), chunk_vertices; // Global indices of the current chunk vertices
+            for (std::size_t i = 0; i + 3 <= nb_indices; i += 3) {
+                const GLuint *tri = indices + i;
+                std::size_t nb_new = (remap[tri[0]] == (GLuint)-1)
+                    + ((remap[tri[1]] == (GLuint)-1) && (tri[1] != tri[0]))
+                    + ((remap[tri[2]] == (GLuint)-1) && (tri[2] != tri[0]) && (tri[2] != tri[1]));
+
+                if (chunk_vertices.size() + nb_new > max_vertices) {
+                    for (GLuint idx: chunk_vertices)
+                        remap[idx] = (GLuint)-1;
+                    chunk_vertices.clear();
+                    chunks.emplace_back();
+                }
+
+                auto &chunk = chunks.back();
+                for (std::size_t j = 0; j < 3; ++j) {
+                    GLuint &local = remap[tri[j]];
+                    if (local == (GLuint)-1) {
+                        local = chunk_vertices.size();
+                        chunk_vertices.push_back(tri[j]), chunk.vertices.push_back(vertices[tri[j]]);
+                    }
+                    chunk.indices.push_back(local);
+                }
+            }
+            return chunks;
+        }
+
+        // Runs the three passes in order, cache statistics are measured before and after
+        template <typename V>
+        static Stats optimize(std::vector<V> &vertices, std::vector<GLuint> &indices) {
+            Stats stats;
+            stats.before = analyze_vertex_cache(indices.data(), indices.size(), vertices.size());
+            optimize_vertex_cache(indices.data(), indices.size(), vertices.size());
+            optimize_overdraw(indices.data(), indices.size(), vertices.data(), vertices.size());
+            vertices.resize(optimize_vertex_fetch(indices.data(), indices.size(), vertices.data(), vertices.size()));
+            stats.after = analyze_vertex_cache(indices.data(), indices.size(), vertices.size());
+            return stats;
+        }
+
+    private:
+        static constexpr std::size_t forsyth_cache_size = 32;
+
+        // Scoring from Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+        static float get_vertex_score(std::int32_t cache_pos, std::uint32_t nb_remaining) {
+            static constexpr float cache_decay_power = 1.5f, last_tri_score = 0.75f;
+            static constexpr float valence_boost_scale = 2.0f, valence_boost_power = 0.5f;
+
+            if (!nb_remaining)
+                return -1.0f;
+
+            float score = 0.0f;
+            if (cache_pos >= 0) {
+                if (cache_pos < 3)
+                    score = last_tri_score; // Equal weights for the last triangle, so its orientation doesn't matter
+                else
+                    score = std::pow(1.0f - (float)(cache_pos - 3) / (forsyth_cache_size - 3), cache_decay_power);
+            }
+            return score + valence_boost_scale * std::pow((float)nb_remaining, -valence_boost_power);
+        }
+};
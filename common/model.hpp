@@ -1,6 +1,11 @@
 #pragma once
 
+#include <cstdint>
+#include <map>
+#include <limits>
+#include <iterator>
 #include <string>
+#include <vector>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <assimp/Importer.hpp>
@@ -9,25 +14,97 @@
 
 #include "shader.hpp"
 #include "mesh.hpp"
+#include "mesh_cache.hpp"
+#include "mesh_optimizer.hpp"
+#include "normal_matrix.hpp"
+#include "render_queue.hpp"
+#include "multi_draw.hpp"
+#include "frustum.hpp"
+#include "bvh.hpp"
+#include "thread_pool.hpp"
 
 class Model {
     public:
+        static constexpr std::uint32_t default_import_flags = aiProcess_Triangulate | aiProcess_FlipUVs;
+
+        // Processing done after the import, on top of the assimp flags
+        enum Options: std::uint32_t {
+            OptimizeMeshes = BIT(0), // Vertex cache, overdraw and vertex fetch ordering (see MeshOptimizer)
+            PackVertices   = BIT(1), // Upload with the 16-byte Mesh::PackedVertex layout, which needs a decoding shader
+            KeepGeometry   = BIT(2), // Keep a CPU copy of the vertices and indices (Mesh::Residency::KeepCpuCopy)
+        };
+
+        // Options that change the extracted geometry, the others only apply at upload
+        static constexpr std::uint32_t cached_options = OptimizeMeshes;
+
         Model() = default;
-        Model(const std::string &path) {
-            load(path);
+        Model(const std::string &path, std::uint32_t flags = default_import_flags, ThreadPool *pool = nullptr,
+                std::uint32_t options = 0) {
+            load(path, flags, pool, options);
         }
 
-        void load(const std::string &path) {
+        // When a pool is given, the per-mesh extraction runs on it and only the GL uploads stay on the calling thread
+        void load(const std::string &path, std::uint32_t flags = default_import_flags, ThreadPool *pool = nullptr,
+                std::uint32_t options = 0) {
+            this->meshes.clear();
+            this->optimize_stats.clear();
+
+            auto format    = (options & PackVertices) ? Mesh::VertexFormat::Packed      : Mesh::VertexFormat::Float;
+            auto residency = (options & KeepGeometry) ? Mesh::Residency::KeepCpuCopy : Mesh::Residency::GpuOnly;
+
+            if (auto mapping = MeshCache::load(path, flags, options & cached_options)) {
+                this->meshes.reserve(mapping->get_meshes().size());
+                for (auto &view: mapping->get_meshes()) {
+                    std::vector<Mesh::Texture> textures = load_textures(view.textures);
+                    this->meshes.emplace_back(view.vertices, view.nb_vertices, view.indices, view.nb_indices, textures, view.bounds, format, residency);
+                }
+                build_bvh();
+                build_buckets();
+                return;
+            }
+
             Assimp::Importer import;
-            const aiScene *scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+            const aiScene *scene = import.ReadFile(path, flags);
 
             if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
                 std::cout << "Could not load model:\n" << import.GetErrorString() << '\n';
                 return;
             }
 
-            this->meshes.clear();
-            process_node(scene->mRootNode, scene);
+            std::vector<const aiMesh *> ai_meshes;
+            process_node(scene->mRootNode, scene, ai_meshes);
+
+            // An imported mesh can be split in several parts, which are flattened once every mesh is done
+            std::vector<std::vector<Mesh::Data>> parts(ai_meshes.size());
+            std::vector<std::vector<MeshOptimizer::Stats>> part_stats(ai_meshes.size());
+            auto extract = [&](std::size_t i) {
+                parts[i] = split_mesh(process_mesh(ai_meshes[i], scene));
+                if (options & OptimizeMeshes)
+                    for (auto &part: parts[i])
+                        part_stats[i].push_back(MeshOptimizer::optimize(part.vertices, part.indices));
+            };
+            if (pool)
+                pool->parallel_for(ai_meshes.size(), extract);
+            else
+                for (std::size_t i = 0; i < ai_meshes.size(); ++i)
+                    extract(i);
+
+            std::vector<Mesh::Data> data;
+            for (std::size_t i = 0; i < parts.size(); ++i) {
+                std::move(parts[i].begin(), parts[i].end(), std::back_inserter(data));
+                this->optimize_stats.insert(this->optimize_stats.end(), part_stats[i].begin(), part_stats[i].end());
+            }
+
+            MeshCache::store(path, flags, data, options & cached_options);
+
+            this->meshes.reserve(data.size());
+            for (auto &mesh: data) {
+                std::vector<Mesh::Texture> textures = load_textures(mesh.textures);
+                this->meshes.emplace_back(mesh.vertices.data(), mesh.vertices.size(),
+                    mesh.indices.data(), mesh.indices.size(), textures, mesh.bounds, format, residency);
+            }
+            build_bvh();
+            build_buckets();
         }
 
         void draw(ShaderProgram &shader) {
@@ -35,71 +112,260 @@ class Model {
                 mesh.draw(shader);
         }
 
+        // Sets the object transform and its normal matrix once for all meshes
+        void draw(ShaderProgram &shader, const glm::mat4 &model) {
+            shader.set_value("u_model",      model);
+            shader.set_value("u_normal_mat", get_normal_matrix(model));
+            draw(shader);
+        }
+
+        // Only draws the meshes whose transformed bounds intersect the frustum
+        void draw(ShaderProgram &shader, const glm::mat4 &model, const Frustum &frustum) {
+            cull(model, frustum);
+            shader.set_value("u_model",      model);
+            shader.set_value("u_normal_mat", get_normal_matrix(model));
+            for (std::size_t i = 0; i < this->meshes.size(); ++i)
+                if (this->visible[i])
+                    this->meshes[i].draw(shader);
+        }
+
+        // Draws the meshes with one multi-draw call per bucket of meshes sharing their textures
+        // (see MultiDrawBatch), instead of one call per mesh
+        void draw_batched(ShaderProgram &shader, const glm::mat4 &model) {
+            draw_buckets(shader, model, nullptr);
+        }
+
+        void draw_batched(ShaderProgram &shader, const glm::mat4 &model, const Frustum &frustum) {
+            draw_buckets(shader, model, &frustum);
+        }
+
+        // The transform is stored in the model, so it must outlive the flush of the queue
+        void submit(RenderQueue &queue, ShaderProgram &shader, const glm::mat4 &model, float depth = 0.0f) {
+            submit_meshes(queue, shader, model, nullptr, depth);
+        }
+
+        void submit(RenderQueue &queue, ShaderProgram &shader, const glm::mat4 &model, const Frustum &frustum, float depth = 0.0f) {
+            submit_meshes(queue, shader, model, &frustum, depth);
+        }
+
+        // Index of the mesh hit first by the ray (in world space), or -1
+        // Meshes with a CPU copy (see KeepGeometry) are tested triangle by triangle, the others by their bounds
+        int pick(const glm::vec3 &origin, const glm::vec3 &dir, const glm::mat4 &model, float *dist = nullptr) const {
+            glm::mat4 inv_model = glm::inverse(model);
+            glm::vec3 obj_origin = glm::vec3(inv_model * glm::vec4(origin, 1.0f)), obj_dir = glm::vec3(inv_model * glm::vec4(dir, 0.0f));
+            glm::vec3 inv_dir = 1.0f / obj_dir;
+
+            // The direction isn't renormalized, so t is the same along both rays
+            Bvh::Hit hit;
+            bool is_hit = this->bvh.raycast(obj_origin, obj_dir, hit, [&](std::uint32_t prim, float t_max) {
+                auto &mesh = this->meshes[prim];
+                float t = Bvh::intersect_box(mesh.get_bounds(), obj_origin, inv_dir, t_max);
+                if (!mesh.is_cpu_resident() || (t >= t_max))
+                    return t;
+
+                auto &vertices = mesh.get_vertices();
+                auto &indices  = mesh.get_indices();
+                float closest = std::numeric_limits<float>::infinity();
+                for (std::size_t i = 0; i + 3 <= indices.size(); i += 3)
+                    closest = std::min(closest, Bvh::intersect_triangle(obj_origin, obj_dir,
+                        vertices[indices[i]].position, vertices[indices[i + 1]].position, vertices[indices[i + 2]].position));
+                return closest;
+            });
+            if (!is_hit)
+                return -1;
+            if (dist)
+                *dist = hit.t * glm::length(dir);
+            return hit.prim;
+        }
+
+        inline const Bvh &get_bvh() const { return this->bvh; }
+
         inline const std::vector<Mesh> &get_meshes() const { return this->meshes; };
 
+        // Per-mesh vertex cache statistics of the last load with OptimizeMeshes, empty if it was served by the mesh cache
+        inline const std::vector<MeshOptimizer::Stats> &get_optimize_stats() const { return this->optimize_stats; }
+
     private:
-        void process_node(aiNode *node, const aiScene *scene) {
-            this->meshes.reserve(node->mNumMeshes);
+        void build_bvh() {
+            std::vector<Aabb> bounds;
+            bounds.reserve(this->meshes.size());
+            for (auto &mesh: this->meshes)
+                bounds.push_back(mesh.get_bounds());
+            this->bvh.build(bounds.data(), bounds.size());
+            this->visible.resize(this->meshes.size());
+        }
+
+        // Packed meshes get a bucket each, as their position decoding is set by uniforms
+        void build_buckets() {
+            this->buckets.clear();
+            std::map<std::vector<GLuint>, std::size_t> bucket_ids;
+            for (std::uint32_t i = 0; i < this->meshes.size(); ++i) {
+                auto &mesh = this->meshes[i];
+                if (mesh.get_format() == Mesh::VertexFormat::Packed) {
+                    this->buckets.emplace_back().meshes.push_back(i);
+                    continue;
+                }
+
+                std::vector<GLuint> key = { mesh.get_index_type() };
+                for (auto &texture: mesh.get_textures())
+                    key.push_back(texture.tex->get_handle()), key.push_back((GLuint)texture.type);
+                auto [it, inserted] = bucket_ids.try_emplace(std::move(key), this->buckets.size());
+                if (inserted)
+                    this->buckets.emplace_back();
+                this->buckets[it->second].meshes.push_back(i);
+            }
+        }
+
+        void draw_buckets(ShaderProgram &shader, const glm::mat4 &model, const Frustum *frustum) {
+            if (frustum)
+                cull(model, *frustum);
+            shader.set_value("u_model",      model);
+            shader.set_value("u_normal_mat", get_normal_matrix(model));
+            for (auto &bucket: this->buckets) {
+                bucket.batch.clear();
+                for (std::uint32_t i: bucket.meshes)
+                    if (!frustum || this->visible[i])
+                        this->meshes[i].add_to(bucket.batch);
+                if (!bucket.batch.get_nb_commands())
+                    continue;
+
+                auto &mesh = this->meshes[bucket.meshes.front()];
+                mesh.set_uniforms(shader);
+                mesh.bind_textures();
+                Mesh::get_arena(mesh.get_format()).bind();
+                bucket.batch.submit(GL_TRIANGLES, mesh.get_index_type());
+            }
+        }
+
+        // The hierarchy is in object space, so the frustum is brought into it rather than the other way around
+        void cull(const glm::mat4 &model, const Frustum &frustum) {
+            std::fill(this->visible.begin(), this->visible.end(), 0);
+            this->bvh.cull(frustum.transform(model), [this](std::uint32_t mesh) { this->visible[mesh] = 1; });
+        }
+
+        void submit_meshes(RenderQueue &queue, ShaderProgram &shader, const glm::mat4 &model, const Frustum *frustum, float depth) {
+            if (frustum)
+                cull(model, *frustum);
+            this->transform  = model;
+            this->normal_mat = get_normal_matrix(model);
+            for (std::size_t i = 0; i < this->meshes.size(); ++i) {
+                if (frustum && !this->visible[i])
+                    continue;
+                auto &mesh = this->meshes[i];
+                DrawItem item = mesh.get_draw_item(shader);
+                item.set_uniforms = [this, &mesh](ShaderProgram &shader) {
+                    shader.set_value("u_model",      this->transform);
+                    shader.set_value("u_normal_mat", this->normal_mat);
+                    mesh.set_uniforms(shader);
+                };
+                queue.submit(std::move(item), depth);
+            }
+        }
+
+        static void process_node(const aiNode *node, const aiScene *scene, std::vector<const aiMesh *> &meshes) {
+            meshes.reserve(meshes.size() + node->mNumMeshes);
             for (std::size_t i = 0; i < node->mNumMeshes; ++i)
-                this->meshes.push_back(process_mesh(scene->mMeshes[node->mMeshes[i]], scene));
+                meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
 
             for (std::size_t i = 0; i < node->mNumChildren; ++i)
-                process_node(node->mChildren[i], scene);
+                process_node(node->mChildren[i], scene, meshes);
         }
 
-        Mesh process_mesh(aiMesh *mesh, const aiScene *scene) {
-            std::vector<Mesh::Vertex>  vertices;
-            std::vector<GLuint>        indices;
-            std::vector<Mesh::Texture> textures;
+        // Only reads from the scene, so it can be called concurrently for different meshes
+        static Mesh::Data process_mesh(const aiMesh *mesh, const aiScene *scene) {
+            Mesh::Data data;
 
-            vertices.reserve(mesh->mNumVertices);
+            data.vertices.reserve(mesh->mNumVertices);
             for (std::size_t i = 0; i < mesh->mNumVertices; ++i) {
                 Mesh::Vertex vert;
                 vert.position   = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
-                vert.normal     = glm::vec3(mesh->mNormals[i].x,  mesh->mNormals[i].y,  mesh->mNormals[i].z);
+                vert.normal     = (mesh->mNormals) ?
+                    glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z) : glm::vec3(0.0f, 0.0f, 0.0f);
                 vert.tex_coords = (mesh->mTextureCoords[0]) ?
                     glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y) : glm::vec2(0.0f, 0.0f);
-                vertices.push_back(vert);
+                data.vertices.push_back(vert);
+                data.bounds.extend(vert.position);
             }
 
+            data.indices.reserve(mesh->mNumFaces * 3);
             for (std::size_t i = 0; i < mesh->mNumFaces; ++i) {
-                aiFace face = mesh->mFaces[i];
-                indices.reserve(face.mNumIndices);
+                const aiFace &face = mesh->mFaces[i];
                 for (GLuint j = 0; j < face.mNumIndices; ++j)
-                    indices.push_back(face.mIndices[j]);
+                    data.indices.push_back(face.mIndices[j]);
             }
 
+            // Assimp only merges vertices with aiProcess_JoinIdenticalVertices, which isn't in the default flags
+            data.vertices.resize(MeshOptimizer::weld_vertices(data.indices.data(), data.indices.size(),
+                data.vertices.data(), data.vertices.size()));
 
             if (mesh->mMaterialIndex >= 0) {
-                aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
-                std::vector<Mesh::Texture> diffuse_maps =
-                    load_textures(material, aiTextureType_DIFFUSE, TextureType::Diffuse);
-                textures.insert(textures.end(), diffuse_maps.begin(), diffuse_maps.end());
-
-                std::vector<Mesh::Texture> specular_maps =
-                    load_textures(material, aiTextureType_SPECULAR, TextureType::Specular);
-                textures.insert(textures.end(), specular_maps.begin(), specular_maps.end());
+                const aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
+                get_texture_refs(material, aiTextureType_DIFFUSE,  TextureType::Diffuse,  data.textures);
+                get_texture_refs(material, aiTextureType_SPECULAR, TextureType::Specular, data.textures);
             }
 
-            return Mesh(vertices, indices, textures);
+            return data;
         }
 
-        std::vector<Mesh::Texture> load_textures(aiMaterial *mat, aiTextureType ass_type, TextureType type) {
-            std::vector<Mesh::Texture> textures;
-            textures.reserve(mat->GetTextureCount(ass_type));
-            for(GLuint i = 0; i < mat->GetTextureCount(ass_type); i++) {
+        // Meshes too large for 16-bit indices are cut into parts that fit, if the index data saved
+        // outweighs the vertices duplicated along the cuts
+        static std::vector<Mesh::Data> split_mesh(Mesh::Data &&mesh) {
+            std::vector<Mesh::Data> res;
+            if (mesh.vertices.size() > Mesh::max_short_vertices) {
+                auto chunks = MeshOptimizer::split(mesh.indices.data(), mesh.indices.size(),
+                    mesh.vertices.data(), mesh.vertices.size(), Mesh::max_short_vertices);
+
+                std::size_t nb_split_vertices = 0;
+                for (auto &chunk: chunks)
+                    nb_split_vertices += chunk.vertices.size();
+                std::size_t split_size = nb_split_vertices    * sizeof(Mesh::Vertex) + mesh.indices.size() * sizeof(GLushort),
+                            whole_size = mesh.vertices.size() * sizeof(Mesh::Vertex) + mesh.indices.size() * sizeof(GLuint);
+
+                if (split_size < whole_size) {
+                    for (auto &chunk: chunks) {
+                        Aabb bounds = Aabb::from_points(chunk.vertices.data(), chunk.vertices.size(), sizeof(Mesh::Vertex));
+                        res.push_back({std::move(chunk.vertices), std::move(chunk.indices), mesh.textures, bounds});
+                    }
+                    return res;
+                }
+            }
+            res.push_back(std::move(mesh));
+            return res;
+        }
+
+        static void get_texture_refs(const aiMaterial *mat, aiTextureType ass_type, TextureType type, std::vector<Mesh::TextureRef> &refs) {
+            refs.reserve(refs.size() + mat->GetTextureCount(ass_type));
+            for (GLuint i = 0; i < mat->GetTextureCount(ass_type); i++) {
                 aiString str;
                 mat->GetTexture(ass_type, i, &str);
+                refs.push_back({type, std::string{str.C_Str()}});
+            }
+        }
+
+        static std::vector<Mesh::Texture> load_textures(const std::vector<Mesh::TextureRef> &refs) {
+            std::vector<Mesh::Texture> textures;
+            textures.reserve(refs.size());
+            for (auto &[type, path]: refs) {
                 textures.push_back({
-                    Texture2d{str.C_Str()},
+                    TextureCache::get(path),
                     type,
-                    std::string{str.C_Str()}
+                    path
                 });
             }
             return textures;
-
         }
 
+        struct Bucket {
+            std::vector<std::uint32_t> meshes;
+            MultiDrawBatch batch;
+        };
+
     protected:
         std::vector<Mesh> meshes;
+        glm::mat4 transform  = glm::mat4(1.0f);
+        glm::mat3 normal_mat = glm::mat3(1.0f);
+        Bvh bvh;
+        std::vector<std::uint8_t> visible;
+        std::vector<MeshOptimizer::Stats> optimize_stats;
+        std::vector<Bucket> buckets;
 };
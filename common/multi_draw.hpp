@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <glad/glad.h>
+
+#include "buffer.hpp"
+#include "render_stats.hpp"
+#include "utils.hpp"
+
+// Layout read by glMultiDrawElementsIndirect, first_index is in indices rather than bytes
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint nb_instances;
+    GLuint first_index;
+    GLint  base_vertex;
+    GLuint base_instance;
+};
+ASSERT_SIZE(DrawElementsIndirectCommand, 20);
+
+// Indexed draws sharing a VAO, an index type and the rest of the GL state, submitted in a single call
+// With ARB_multi_draw_indirect the commands go through a draw indirect buffer, otherwise they are
+// passed as arrays to glMultiDrawElementsBaseVertex (core since 3.2, but without instancing)
+class MultiDrawBatch {
+    public:
+        MultiDrawBatch(bool allow_indirect = true): use_indirect(allow_indirect && is_indirect_supported()) { }
+
+        void clear() {
+            this->commands.clear();
+        }
+
+        // first is a byte offset into the element buffer, as for glDrawElements
+        void push(GLsizei count, GLenum index_type, std::uintptr_t first, GLint base_vertex, GLsizei nb_instances = 1) {
+            this->commands.push_back({ (GLuint)count, (GLuint)nb_instances, (GLuint)(first / get_index_size(index_type)),
+                base_vertex, 0 });
+        }
+
+        // The VAO holding the element buffer must be bound
+        void submit(GLenum mode, GLenum index_type) {
+            if (this->commands.empty())
+                return;
+
+            if (this->use_indirect) {
+                if (!this->indirect_buffer)
+                    this->indirect_buffer = std::make_unique<DrawIndirectBuffer<>>();
+                this->indirect_buffer->bind();
+                // Orphans the previous storage, so the GPU can keep reading it while the new commands are written
+                this->indirect_buffer->set_data(this->commands.data(),
+                    this->commands.size() * sizeof(DrawElementsIndirectCommand), GL_STREAM_DRAW);
+                glMultiDrawElementsIndirect(mode, index_type, nullptr, this->commands.size(), 0);
+            } else {
+                this->counts.resize(this->commands.size());
+                this->offsets.resize(this->commands.size());
+                this->base_vertices.resize(this->commands.size());
+                std::size_t index_size = get_index_size(index_type);
+                for (std::size_t i = 0; i < this->commands.size(); ++i) {
+                    auto &cmd = this->commands[i];
+                    this->counts[i]        = cmd.count;
+                    this->offsets[i]       = (const void *)((std::uintptr_t)cmd.first_index * index_size);
+                    this->base_vertices[i] = cmd.base_vertex;
+                }
+                glMultiDrawElementsBaseVertex(mode, this->counts.data(), index_type, this->offsets.data(),
+                    this->commands.size(), this->base_vertices.data());
+            }
+
+            auto &stats = RenderStats::get();
+            ++stats.nb_draws, stats.nb_multi_draws += this->commands.size();
+            for (auto &cmd: this->commands)
+                stats.nb_instances += cmd.nb_instances;
+        }
+
+        inline std::size_t get_nb_commands() const { return this->commands.size(); }
+        inline bool        is_indirect()     const { return this->use_indirect; }
+
+        static inline bool is_indirect_supported() {
+            return GLAD_GL_ARB_draw_indirect && GLAD_GL_ARB_multi_draw_indirect;
+        }
+
+        static inline std::size_t get_index_size(GLenum index_type) {
+            return (index_type == GL_UNSIGNED_BYTE) ? 1 : (index_type == GL_UNSIGNED_SHORT) ? 2 : 4;
+        }
+
+    protected:
+        bool use_indirect;
+        std::vector<DrawElementsIndirectCommand> commands;
+        std::unique_ptr<DrawIndirectBuffer<>> indirect_buffer;
+
+        // Fallback arguments
+        std::vector<GLsizei> counts;
+        std::vector<const void *> offsets;
+        std::vector<GLint> base_vertices;
+};
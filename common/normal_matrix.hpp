@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#ifdef __SSE__
+#   include <xmmintrin.h>
+#endif
+
+// Normal matrices computed on the CPU, once per object rather than once per vertex in the shader
+// For a model matrix whose upper 3x3 has columns a, b, c:
+//   transpose(inverse(mat3(M))) = [b x c, c x a, a x b] / det, with det = a . (b x c)
+// which only takes three cross products and a reciprocal
+
+inline glm::mat3 get_normal_matrix(const glm::mat4 &model) {
+    glm::vec3 a(model[0]), b(model[1]), c(model[2]);
+    glm::vec3 bc = glm::cross(b, c);
+    float inv_det = 1.0f / glm::dot(a, bc);
+    return glm::mat3(bc * inv_det, glm::cross(c, a) * inv_det, glm::cross(a, b) * inv_det);
+}
+
+#ifdef __SSE__
+
+// Cross product of the xyz lanes, w comes out as 0
+inline __m128 cross_ps(__m128 a, __m128 b) {
+    __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+    return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+#endif
+
+inline void compute_normal_matrices(const glm::mat4 *models, glm::mat3 *normals, std::size_t n) {
+#ifdef __SSE__
+    for (std::size_t i = 0; i < n; ++i) {
+        const float *m = glm::value_ptr(models[i]);
+        __m128 a = _mm_loadu_ps(m), b = _mm_loadu_ps(m + 4), c = _mm_loadu_ps(m + 8);
+        __m128 bc = cross_ps(b, c), ca = cross_ps(c, a), ab = cross_ps(a, b);
+
+        // bc.w is 0, so the horizontal sum of a * bc is the determinant
+        __m128 det = _mm_mul_ps(a, bc);
+        det = _mm_add_ps(det, _mm_shuffle_ps(det, det, _MM_SHUFFLE(2, 3, 0, 1)));
+        det = _mm_add_ps(det, _mm_shuffle_ps(det, det, _MM_SHUFFLE(1, 0, 3, 2)));
+        __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+        // Columns are 3 floats apart: each store overwrites the padding lane of the previous one,
+        // and the last column is written in two parts to stay within the matrix
+        float *out = glm::value_ptr(normals[i]);
+        __m128 col_2 = _mm_mul_ps(ab, inv_det);
+        _mm_storeu_ps(out,     _mm_mul_ps(bc, inv_det));
+        _mm_storeu_ps(out + 3, _mm_mul_ps(ca, inv_det));
+        _mm_storel_pi((__m64 *)(out + 6), col_2);
+        _mm_store_ss(out + 8, _mm_movehl_ps(col_2, col_2));
+    }
+#else
+    for (std::size_t i = 0; i < n; ++i)
+        normals[i] = get_normal_matrix(models[i]);
+#endif
+}
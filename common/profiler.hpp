@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <glad/glad.h>
+
+#include "utils.hpp"
+
+// CPU/GPU profiler with scoped zones, exported as a Chrome trace (chrome://tracing, Perfetto)
+// GPU times come from GL_TIMESTAMP queries, taken from a pool per frame in flight:
+// a frame's results are only read back when its pool comes up for reuse, and are dropped
+// rather than waited for if the GPU hasn't produced them by then
+// Disabled unless LOGL_TRACE names an output file or set_enabled(true) is called
+class Profiler {
+    public:
+        static constexpr std::size_t nb_frames_in_flight = 2;
+
+        struct Zone {
+            const char *name;
+            std::uint32_t depth;
+            std::int64_t cpu_begin, cpu_end; // ns since the profiler epoch
+            std::int64_t gpu_begin, gpu_end; // ns on the same timeline, -1 while unknown
+        };
+
+        static bool is_enabled() {
+            if (s_enabled < 0) {
+                const char *env = std::getenv("LOGL_TRACE");
+                s_trace_path = env ? env : "";
+                s_enabled = !s_trace_path.empty();
+            }
+            return s_enabled;
+        }
+
+        static void set_enabled(bool val) { is_enabled(), s_enabled = val; }
+
+        // Opens a frame-wide zone, and collects the results of the last frame that used this pool
+        static void begin_frame() {
+            if (!is_enabled())
+                return;
+            if (!s_calibrated)
+                calibrate();
+
+            auto &frame = s_frames[s_frame_idx % nb_frames_in_flight];
+            collect(frame, false);
+            s_frame_zone = begin_zone("Frame");
+        }
+
+        static void end_frame() {
+            if (!is_enabled() || (s_frame_zone == npos))
+                return;
+            end_zone(s_frame_zone);
+            s_frame_zone = npos;
+            ++s_frame_idx;
+        }
+
+        static std::size_t begin_zone(const char *name) {
+            auto &frame = s_frames[s_frame_idx % nb_frames_in_flight];
+            std::size_t idx = frame.zones.size();
+            frame.zones.push_back({name, s_depth++, get_cpu_time(), 0, -1, -1});
+            frame.zone_queries.push_back({issue_query(frame), 0});
+            return idx;
+        }
+
+        static void end_zone(std::size_t idx) {
+            auto &frame = s_frames[s_frame_idx % nb_frames_in_flight];
+            frame.zone_queries[idx].second = issue_query(frame);
+            frame.zones[idx].cpu_end = get_cpu_time();
+            --s_depth;
+        }
+
+        // Zones of the most recent frame whose GPU results were collected
+        static inline const std::vector<Zone> &get_last_frame() { return s_last_frame; }
+        static inline std::size_t get_nb_dropped_frames()      { return s_nb_dropped; }
+
+        // Waits for the frames still in flight, then writes every collected zone
+        // Returns false if the profiler is disabled or the file can't be written
+        static bool write_trace(const std::string &path = {}) {
+            if (!is_enabled())
+                return false;
+            for (std::size_t i = 0; i < nb_frames_in_flight; ++i)
+                collect(s_frames[(s_frame_idx + i) % nb_frames_in_flight], true);
+
+            const std::string &out_path = path.empty() ? s_trace_path : path;
+            std::FILE *fp = std::fopen(out_path.c_str(), "w");
+            if (!fp) {
+                std::cout << "Could not open " << out_path << '\n';
+                return false;
+            }
+
+            std::fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+                "{\"ph\":\"M\",\"pid\":1,\"tid\":1,\"name\":\"thread_name\",\"args\":{\"name\":\"CPU\"}},\n"
+                "{\"ph\":\"M\",\"pid\":1,\"tid\":2,\"name\":\"thread_name\",\"args\":{\"name\":\"GPU\"}}");
+            for (auto &zone: s_trace) {
+                std::fprintf(fp, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":1,\"name\":\"%s\",\"ts\":%.3f,\"dur\":%.3f}",
+                    zone.name, zone.cpu_begin / 1e3, (zone.cpu_end - zone.cpu_begin) / 1e3);
+                if (zone.gpu_begin >= 0)
+                    std::fprintf(fp, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":2,\"name\":\"%s\",\"ts\":%.3f,\"dur\":%.3f}",
+                        zone.name, zone.gpu_begin / 1e3, (zone.gpu_end - zone.gpu_begin) / 1e3);
+            }
+            std::fprintf(fp, "\n]}\n");
+            return !std::fclose(fp);
+        }
+
+    private:
+        static constexpr std::size_t npos = -1;
+
+        struct Frame {
+            std::vector<Zone> zones;
+            std::vector<std::pair<std::size_t, std::size_t>> zone_queries; // Begin/end indices into queries
+            std::vector<GLuint> queries;
+            std::size_t nb_used_queries;
+        };
+
+        static std::int64_t get_cpu_time() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_epoch).count();
+        }
+
+        // Maps GPU timestamps onto the CPU timeline, so both tracks line up in the trace
+        static void calibrate() {
+            GLint64 gpu_now;
+            glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+            s_gpu_offset = get_cpu_time() - gpu_now;
+            s_calibrated = true;
+        }
+
+        static std::size_t issue_query(Frame &frame) {
+            if (frame.nb_used_queries == frame.queries.size()) {
+                std::size_t prev_size = frame.queries.size();
+                frame.queries.resize(std::max(prev_size * 2, (std::size_t)64));
+                glGenQueries(frame.queries.size() - prev_size, frame.queries.data() + prev_size);
+            }
+            glQueryCounter(frame.queries[frame.nb_used_queries], GL_TIMESTAMP);
+            return frame.nb_used_queries++;
+        }
+
+        static void collect(Frame &frame, bool wait) {
+            if (frame.zones.empty())
+                return;
+
+            // Queries complete in order, so the last one being available means they all are
+            GLuint available = wait;
+            if (!wait)
+                glGetQueryObjectuiv(frame.queries[frame.nb_used_queries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+            if (available) {
+                auto get_result = [&frame](std::size_t idx) {
+                    GLuint64 ts;
+                    glGetQueryObjectui64v(frame.queries[idx], GL_QUERY_RESULT, &ts);
+                    return (std::int64_t)ts + s_gpu_offset;
+                };
+                for (std::size_t i = 0; i < frame.zones.size(); ++i) {
+                    frame.zones[i].gpu_begin = get_result(frame.zone_queries[i].first);
+                    frame.zones[i].gpu_end   = get_result(frame.zone_queries[i].second);
+                }
+                s_last_frame = frame.zones;
+            } else {
+                ++s_nb_dropped;
+            }
+
+            s_trace.insert(s_trace.end(), frame.zones.begin(), frame.zones.end());
+            frame.zones.clear();
+            frame.zone_queries.clear();
+            frame.nb_used_queries = 0;
+        }
+
+    protected:
+        static inline int s_enabled = -1;
+        static inline std::string s_trace_path;
+        static inline bool s_calibrated = false;
+
+        static inline const auto s_epoch = std::chrono::steady_clock::now();
+        static inline std::int64_t s_gpu_offset = 0;
+
+        static inline Frame s_frames[nb_frames_in_flight];
+        static inline std::size_t s_frame_idx = 0, s_frame_zone = npos, s_nb_dropped = 0;
+        static inline std::uint32_t s_depth = 0;
+
+        static inline std::vector<Zone> s_trace, s_last_frame;
+};
+
+// Times the enclosing scope on the CPU and the GPU
+class ProfileZone {
+    public:
+        ProfileZone(const char *name) {
+            if (Profiler::is_enabled())
+                this->idx = Profiler::begin_zone(name);
+        }
+
+        ~ProfileZone() {
+            if (this->idx != (std::size_t)-1)
+                Profiler::end_zone(this->idx);
+        }
+
+        ProfileZone(const ProfileZone &) = delete;
+        ProfileZone &operator=(const ProfileZone &) = delete;
+
+    protected:
+        std::size_t idx = -1;
+};
+
+#define PROFILE_ZONE(name) ProfileZone CONCATENATE(_profile_zone_, __LINE__){name}
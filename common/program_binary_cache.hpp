@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <glad/glad.h>
+
+#include "utils.hpp"
+
+// On-disk cache of linked program binaries (GL_ARB_get_program_binary)
+// Entries are keyed by the sources of every attached shader and the driver identification strings,
+// so a driver update or a shader edit simply misses and relinks from source
+class ProgramBinaryCache {
+    public:
+        static constexpr std::uint32_t magic   = 0x4e425250; // "PRBN"
+        static constexpr std::uint32_t version = 1;
+
+        struct Header {
+            std::uint32_t magic, version;
+            std::uint32_t format, length;
+        };
+        ASSERT_SIZE(Header, 16);
+
+        // Disabled unless a directory is given, here or through LOGL_PROGRAM_CACHE
+        static void set_directory(const std::string &dir) { s_directory = dir; }
+        static inline const std::string &get_directory()  { return s_directory; }
+
+        // For applications opting in: LOGL_PROGRAM_CACHE still wins when set, an empty value disabling the cache
+        static void set_default_directory(const std::string &dir) {
+            if (!std::getenv(env_name))
+                s_directory = dir;
+        }
+
+        static bool is_enabled() {
+            return !s_directory.empty() && GLAD_GL_ARB_get_program_binary;
+        }
+
+        template <typename ...Shaders>
+        static std::uint64_t get_key(const Shaders &...shaders) {
+            std::uint64_t key = fnv1a_64(get_driver_id());
+            ((key = fnv1a_64(shaders.get_source(), fnv1a_64(std::to_string(shaders.get_type()), key))), ...);
+            return key;
+        }
+
+        // Returns whether the program was restored and linked successfully
+        static bool load(GLuint program, std::uint64_t key) {
+            std::ifstream fp{get_cache_path(key), std::ios::in | std::ios::binary};
+            if (!fp.is_open())
+                return false;
+
+            Header header;
+            fp.read((char *)&header, sizeof(header));
+            if (!fp || (header.magic != magic) || (header.version != version))
+                return false;
+
+            std::vector<char> binary(header.length);
+            fp.read(binary.data(), binary.size());
+            if (!fp)
+                return false;
+
+            GLint rc;
+            glProgramBinary(program, header.format, binary.data(), binary.size());
+            glGetProgramiv(program, GL_LINK_STATUS, &rc);
+            if (!rc)
+                remove(key);
+            return rc;
+        }
+
+        static bool store(GLuint program, std::uint64_t key) {
+            GLint length = 0;
+            glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+            if (length <= 0)
+                return false;
+
+            Header header = { magic, version, 0, (std::uint32_t)length };
+            std::vector<char> binary(length);
+            glGetProgramBinary(program, length, nullptr, (GLenum *)&header.format, binary.data());
+
+            std::error_code ec;
+            std::filesystem::create_directories(s_directory, ec);
+
+            std::string path = get_cache_path(key), tmp_path = path + ".tmp";
+            std::ofstream fp{tmp_path, std::ios::out | std::ios::binary | std::ios::trunc};
+            if (!fp.is_open())
+                return false;
+            fp.write((const char *)&header, sizeof(header));
+            fp.write(binary.data(), binary.size());
+            fp.close();
+            if (fp.fail()) {
+                std::filesystem::remove(tmp_path, ec);
+                return false;
+            }
+            std::filesystem::rename(tmp_path, path, ec);
+            return !ec;
+        }
+
+        static void remove(std::uint64_t key) {
+            if (s_directory.empty())
+                return;
+            std::error_code ec;
+            std::filesystem::remove(get_cache_path(key), ec);
+        }
+
+    private:
+        static constexpr const char *env_name = "LOGL_PROGRAM_CACHE";
+
+        static std::string get_driver_id() {
+            std::string id;
+            for (GLenum name: {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+                if (auto *str = (const char *)glGetString(name))
+                    id += str;
+                id += '\n';
+            }
+            return id;
+        }
+
+        static std::string get_cache_path(std::uint64_t key) {
+            char name[0x20];
+            std::snprintf(name, sizeof(name), "%016" PRIx64 ".prog", key);
+            return (std::filesystem::path(s_directory) / name).string();
+        }
+
+    protected:
+        static inline std::string s_directory = [] {
+            const char *env = std::getenv(env_name);
+            return std::string(env ? env : "");
+        }();
+};
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <glad/glad.h>
+
+#include "shader_program.hpp"
+#include "vertex_array.hpp"
+#include "texture.hpp"
+#include "render_stats.hpp"
+
+// 2d textures bound to consecutive units, starting at 0
+struct TextureSet {
+    static constexpr std::size_t max_textures = 8;
+
+    std::array<GLuint, max_textures> handles = {};
+    std::uint8_t nb_textures = 0;
+
+    TextureSet() = default;
+    TextureSet(std::initializer_list<GLuint> handles) {
+        for (GLuint handle: handles)
+            push(handle);
+    }
+
+    void push(GLuint handle) {
+        if (this->nb_textures < max_textures)
+            this->handles[this->nb_textures++] = handle;
+    }
+
+    // Only used to group items in the sort key, collisions cost extra binds but are otherwise harmless
+    std::uint16_t get_hash() const {
+        std::uint32_t hash = 0x811c9dc5;
+        for (std::size_t i = 0; i < this->nb_textures; ++i)
+            hash = (hash ^ this->handles[i]) * 0x01000193;
+        return hash ^ (hash >> 16);
+    }
+};
+
+struct DrawItem {
+    ShaderProgram *program;
+    GLuint vao;
+    TextureSet textures;
+
+    GLenum mode = GL_TRIANGLES;
+    GLsizei count = 0;
+    GLenum index_type = 0;     // 0 for non-indexed draws
+    std::uintptr_t first = 0;  // First vertex, or byte offset into the element buffer
+    GLint base_vertex = 0;     // Added to the indices
+    GLsizei nb_instances = 1;
+
+    // Called with the program bound, right before the draw
+    std::function<void(ShaderProgram &)> set_uniforms;
+};
+
+// Collects the draws of a frame, sorts them by state and submits them without redundant binds
+// The sort key orders by program, then VAO, then texture set, then depth:
+//   63      52 51      40 39             24 23         0
+//   | program | vao     | texture set hash | depth      |
+class RenderQueue {
+    public:
+        struct Stats {
+            std::size_t nb_items;
+            std::size_t nb_program_binds, nb_vao_binds, nb_texture_binds;
+            std::size_t nb_program_binds_avoided, nb_vao_binds_avoided, nb_texture_binds_avoided;
+
+            inline std::size_t get_nb_binds() const {
+                return this->nb_program_binds + this->nb_vao_binds + this->nb_texture_binds;
+            }
+
+            inline std::size_t get_nb_binds_avoided() const {
+                return this->nb_program_binds_avoided + this->nb_vao_binds_avoided + this->nb_texture_binds_avoided;
+            }
+        };
+
+        // depth is expected in [0, 1] (eg. normalized view distance), smaller values are drawn first
+        static std::uint64_t make_key(const DrawItem &item, float depth) {
+            std::uint64_t program = item.program->get_handle() & 0xfff, vao = item.vao & 0xfff;
+            std::uint64_t depth_bits = std::clamp(depth, 0.0f, 1.0f) * (float)0xffffff;
+            return (program << 52) | (vao << 40) | ((std::uint64_t)item.textures.get_hash() << 24) | depth_bits;
+        }
+
+        void submit(DrawItem item, float depth = 0.0f) {
+            this->keys.push_back({make_key(item, depth), (std::uint32_t)this->items.size()});
+            this->items.push_back(std::move(item));
+        }
+
+        // Draws and clears the queued items
+        // Bindings made outside the queue aren't tracked, so the first item always binds its full state
+        void flush() {
+            sort();
+
+            this->stats = {};
+            this->stats.nb_items = this->items.size();
+
+            ShaderProgram *cur_program = nullptr;
+            GLuint cur_vao = -1;
+            std::array<GLuint, TextureSet::max_textures> cur_textures;
+            cur_textures.fill(-1);
+
+            for (auto &[key, idx]: this->keys) {
+                auto &item = this->items[idx];
+
+                if (item.program != cur_program)
+                    item.program->use(), cur_program = item.program, ++this->stats.nb_program_binds;
+                else
+                    ++this->stats.nb_program_binds_avoided;
+
+                if (item.vao != cur_vao)
+                    VertexArray<>::bind(item.vao), cur_vao = item.vao, ++this->stats.nb_vao_binds;
+                else
+                    ++this->stats.nb_vao_binds_avoided;
+
+                for (GLuint i = 0; i < item.textures.nb_textures; ++i) {
+                    if (item.textures.handles[i] == cur_textures[i]) {
+                        ++this->stats.nb_texture_binds_avoided;
+                        continue;
+                    }
+                    Texture2d<>::bind_unit(i, item.textures.handles[i]), cur_textures[i] = item.textures.handles[i];
+                    ++this->stats.nb_texture_binds;
+                }
+
+                if (item.set_uniforms)
+                    item.set_uniforms(*item.program);
+
+                if (item.index_type)
+                    draw_elements(item.mode, item.count, item.index_type, (const void *)item.first, item.nb_instances, item.base_vertex);
+                else
+                    draw_arrays(item.mode, item.first, item.count, item.nb_instances);
+            }
+
+            Texture2d<>::active(0);
+            clear();
+        }
+
+        void clear() {
+            this->items.clear();
+            this->keys.clear();
+        }
+
+        inline std::size_t get_nb_items() const { return this->items.size(); }
+
+        // Counters of the last flush
+        inline const Stats &get_stats() const { return this->stats; }
+
+    private:
+        using KeyIdx = std::pair<std::uint64_t, std::uint32_t>;
+
+        // LSD radix sort on bytes, skipping the passes where every key has the same digit
+        // (typically the high bytes, as there are only a handful of programs and VAOs)
+        void sort() {
+            std::size_t n = this->keys.size();
+            if (n < 2)
+                return;
+
+            std::size_t counts[8][0x100] = {};
+            for (auto &[key, idx]: this->keys)
+                for (std::size_t d = 0; d < 8; ++d)
+                    ++counts[d][(key >> (d * 8)) & 0xff];
+
+            this->tmp.resize(n);
+            for (std::size_t d = 0; d < 8; ++d) {
+                auto &count = counts[d];
+                if (count[(this->keys[0].first >> (d * 8)) & 0xff] == n)
+                    continue;
+
+                std::size_t offsets[0x100], off = 0;
+                for (std::size_t i = 0; i < 0x100; ++i)
+                    offsets[i] = off, off += count[i];
+                for (auto &entry: this->keys)
+                    this->tmp[offsets[(entry.first >> (d * 8)) & 0xff]++] = entry;
+                this->keys.swap(this->tmp);
+            }
+        }
+
+    protected:
+        std::vector<DrawItem> items;
+        std::vector<KeyIdx> keys, tmp;
+        Stats stats = {};
+};
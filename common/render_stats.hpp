@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <glad/glad.h>
+
+// Process-wide counters of draw calls and GL state changes issued through the common wrappers
+// Reset them once per frame to get per-frame figures
+struct RenderStats {
+    std::size_t nb_draws, nb_instances;
+    std::size_t nb_program_binds, nb_vao_binds, nb_buffer_binds, nb_texture_binds;
+    std::size_t nb_visible, nb_culled; // Objects that passed/failed frustum culling
+    std::size_t nb_multi_draws;        // Draws folded into multi-draw calls, each call counts once in nb_draws
+
+    inline std::size_t get_nb_state_changes() const {
+        return this->nb_program_binds + this->nb_vao_binds + this->nb_buffer_binds + this->nb_texture_binds;
+    }
+
+    static inline RenderStats &get() {
+        static RenderStats stats;
+        return stats;
+    }
+
+    static inline void reset() { get() = {}; }
+};
+
+inline void draw_arrays(GLenum mode, GLint first, GLsizei count, GLsizei nb_instances = 1) {
+    if (nb_instances == 1)
+        glDrawArrays(mode, first, count);
+    else
+        glDrawArraysInstanced(mode, first, count, nb_instances);
+    ++RenderStats::get().nb_draws, RenderStats::get().nb_instances += nb_instances;
+}
+
+// A base vertex is added to every index, so meshes sharing buffers can keep indices relative to their first vertex
+inline void draw_elements(GLenum mode, GLsizei count, GLenum type, const void *off = nullptr, GLsizei nb_instances = 1,
+        GLint base_vertex = 0) {
+    if ((nb_instances == 1) && !base_vertex)
+        glDrawElements(mode, count, type, off);
+    else if (nb_instances == 1)
+        glDrawElementsBaseVertex(mode, count, type, off, base_vertex);
+    else if (!base_vertex)
+        glDrawElementsInstanced(mode, count, type, off, nb_instances);
+    else
+        glDrawElementsInstancedBaseVertex(mode, count, type, off, nb_instances, base_vertex);
+    ++RenderStats::get().nb_draws, RenderStats::get().nb_instances += nb_instances;
+}
@@ -16,6 +16,8 @@ class Shader: public GlObject {
                 throw std::runtime_error("Could not create Buffer object");
         }
 
+        // Compilation is deferred to the first program that links with this shader,
+        // so it can be skipped entirely when that program is restored from a binary
         Shader(const std::string &path): Shader() {
             std::ifstream fp{path, std::ios::in | std::ios::ate};
             if (!fp.is_open() || fp.bad())
@@ -25,28 +27,38 @@ class Shader: public GlObject {
             fp.seekg(0);
             fp.read(src.data(), size);
             set_source(src);
-            if (!compile()) {
-                print_log();
-                throw std::runtime_error("Could not compile shader");
-            }
         }
 
         ~Shader() {
             glDeleteShader(get_handle());
         }
 
-        void set_source(const std::string &src) const {
+        void set_source(const std::string &src) {
             const char *dat = src.c_str();
             glShaderSource(get_handle(), 1, &dat, NULL);
+            this->source = src;
+            this->compiled = false;
         }
 
         GLint compile() const {
             GLint rc;
             glCompileShader(get_handle());
             glGetShaderiv(get_handle(), GL_COMPILE_STATUS, &rc);
+            this->compiled = rc;
             return rc;
         }
 
+        void ensure_compiled() const {
+            if (this->compiled)
+                return;
+            if (!compile()) {
+                print_log();
+                throw std::runtime_error("Could not compile shader");
+            }
+        }
+
+        inline const std::string &get_source() const { return this->source; }
+
         std::string get_log() const {
             std::string str(0x200, 0);
             glGetShaderInfoLog(get_handle(), str.size(), nullptr, (char *)str.data());
@@ -58,6 +70,10 @@ class Shader: public GlObject {
         }
 
         static inline GLenum get_type() { return Type; }
+
+    protected:
+        std::string source;
+        mutable bool compiled = false;
 };
 
 class VertexShader: public Shader<GL_VERTEX_SHADER> {
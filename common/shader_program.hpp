@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <iostream>
 #include <algorithm>
@@ -8,12 +10,57 @@
 #include <utility>
 #include <stdexcept>
 #include <map>
+#include <vector>
+#include <string_view>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "shader.hpp"
 #include "object.hpp"
+#include "program_binary_cache.hpp"
+#include "render_stats.hpp"
+#include "utils.hpp"
+
+// Hashed uniform name, resolved against the location table a program builds after linking
+// Array indices and struct fields are hashed incrementally, so names like "u_light[2].position"
+// can be formed every frame without allocating or comparing strings
+class UniformId {
+    public:
+        constexpr UniformId(const char *name): hash(fnv1a_32(name)), name(name) { }
+        UniformId(const std::string &name): hash(fnv1a_32(name)), name(nullptr) { } // The string may not outlive the id
+
+        constexpr UniformId append(std::string_view str) const {
+            return UniformId(fnv1a_32(str, this->hash));
+        }
+
+        constexpr UniformId append(std::size_t n) const {
+            std::size_t div = 1;
+            while (n / div >= 10)
+                div *= 10;
+            std::uint32_t h = this->hash;
+            for (; div; div /= 10)
+                h = fnv1a_32(std::string_view("0123456789" + (n / div) % 10, 1), h);
+            return UniformId(h);
+        }
+
+        constexpr UniformId operator[](std::size_t idx) const { return append("[").append(idx).append("]"); }
+        constexpr UniformId field(std::string_view name) const { return append(".").append(name); }
+
+        constexpr std::uint32_t get_hash() const { return this->hash; }
+        constexpr const char   *get_name() const { return this->name; } // Only known for names that weren't appended to
+
+    private:
+        constexpr explicit UniformId(std::uint32_t hash): hash(hash), name(nullptr) { }
+
+    protected:
+        std::uint32_t hash;
+        const char *name;
+};
+
+constexpr UniformId operator""_u(const char *str, std::size_t len) {
+    return UniformId(str);
+}
 
 class ShaderProgram: public GlObject {
     public:
@@ -22,13 +69,26 @@ class ShaderProgram: public GlObject {
                 throw std::runtime_error("Could not create Buffer object");
         }
 
+        // Restores the program from the binary cache when possible, otherwise compiles and links from source
         template <typename ...Shaders>
         ShaderProgram(Shaders &&...shaders): ShaderProgram() {
+            bool use_cache = ProgramBinaryCache::is_enabled();
+            std::uint64_t key = use_cache ? ProgramBinaryCache::get_key(shaders...) : 0;
+            if (use_cache && ProgramBinaryCache::load(get_handle(), key)) {
+                build_uniform_table();
+                return;
+            }
+
+            (shaders.ensure_compiled(), ...);
             set_shaders(std::forward<Shaders>(shaders)...);
+            if (use_cache)
+                glProgramParameteri(get_handle(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
             if (!link()) {
                 print_log();
                 throw std::runtime_error("Could not link shader program");
             }
+            if (use_cache)
+                ProgramBinaryCache::store(get_handle(), key);
         }
 
         ~ShaderProgram() {
@@ -40,76 +100,126 @@ class ShaderProgram: public GlObject {
             (glAttachShader(get_handle(), shaders.get_handle()), ...);
         }
 
-        GLint link() const {
+        GLint link() {
             GLint rc;
             glLinkProgram(get_handle());
             glGetProgramiv(get_handle(), GL_LINK_STATUS, &rc);
-            if (rc); // delete shaders
+            if (rc)
+                build_uniform_table();
             return rc;
         }
 
         void use() const {
             glUseProgram(get_handle());
+            ++RenderStats::get().nb_program_binds;
         }
 
         static void unuse() {
             glUseProgram(0);
+            ++RenderStats::get().nb_program_binds;
         }
 
         inline void bind() const { use(); }
         inline static void unbind() { unuse(); }
 
-        inline GLint get_uniform_loc(const std::string &name) {
-            auto it = this->uniform_loc_cache.find(name);
-            if (it != this->uniform_loc_cache.end())
-                return it->second;
-            GLint loc = glGetUniformLocation(get_handle(), name.c_str());
-            if (loc == -1)
-                std::cout << "Could not find uniform " << name << '\n';
-            this->uniform_loc_cache[name] = loc;
+        // Open-addressed lookup on the name hash, no string comparison involved
+        inline GLint get_uniform_loc(UniformId id) {
+            GLint loc;
+            if (find_uniform(id, loc))
+                return loc;
+
+            // Unknown name: remember it so the warning is only printed once
+            if (id.get_name())
+                std::cout << "Could not find uniform " << id.get_name() << '\n';
+            else
+                std::cout << "Could not find uniform with hash 0x" << std::hex << id.get_hash() << std::dec << '\n';
+            insert_uniform(get_table_key(id.get_hash()), -1);
+            return -1;
+        }
+
+        // Same as get_uniform_loc, without the warning, for uniforms a program may leave out
+        inline GLint get_optional_uniform_loc(UniformId id) {
+            GLint loc;
+            if (!find_uniform(id, loc))
+                insert_uniform(get_table_key(id.get_hash()), loc = -1);
             return loc;
+        }
 
+        // Points the named uniform block at a buffer binding index
+        void bind_uniform_block(const char *name, GLuint binding) const {
+            GLuint idx = glGetUniformBlockIndex(get_handle(), name);
+            if (idx == GL_INVALID_INDEX) {
+                std::cout << "Could not find uniform block " << name << '\n';
+                return;
+            }
+            glUniformBlockBinding(get_handle(), idx, binding);
         }
 
+        // Values are shadowed per location, and calls that wouldn't change the program state are dropped
+        // Uniforms set behind the program's back (raw glUniform*) must be followed by invalidate_uniform_shadows()
         template <typename T>
-        void set_value(GLint loc, const T &val) const {
-            if constexpr (std::is_same_v<T, GLboolean> || std::is_same_v<T, GLint>)
-                glUniform1i(loc, (int)val);
-            else if constexpr (std::is_same_v<T, GLfloat>)
-                glUniform1f(loc, val);
-            else if constexpr (std::is_same_v<T, glm::vec2>)
-                glUniform2fv(loc, 1, glm::value_ptr(val));
-            else if constexpr (std::is_same_v<T, glm::vec3>)
-                glUniform3fv(loc, 1, glm::value_ptr(val));
-            else if constexpr (std::is_same_v<T, glm::vec4>)
-                glUniform4fv(loc, 1, glm::value_ptr(val));
-            else if constexpr (std::is_same_v<T, glm::mat2>)
-                glUniformMatrix2fv(loc, 1, GL_FALSE, glm::value_ptr(val));
-            else if constexpr (std::is_same_v<T, glm::mat3>)
-                glUniformMatrix3fv(loc, 1, GL_FALSE, glm::value_ptr(val));
-            else if constexpr (std::is_same_v<T, glm::mat4>)
-                glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(val));
-            else
+        void set_value(GLint loc, const T &val) {
+            if constexpr (std::is_same_v<T, GLboolean> || std::is_same_v<T, GLint>) {
+                int v = (int)val;
+                if (update_shadow(loc, &v, sizeof(v)))
+                    glUniform1i(loc, v);
+            } else if constexpr (std::is_same_v<T, GLfloat>) {
+                if (update_shadow(loc, &val, sizeof(val)))
+                    glUniform1f(loc, val);
+            } else if constexpr (std::is_same_v<T, glm::vec2>) {
+                if (update_shadow(loc, glm::value_ptr(val), sizeof(val)))
+                    glUniform2fv(loc, 1, glm::value_ptr(val));
+            } else if constexpr (std::is_same_v<T, glm::vec3>) {
+                if (update_shadow(loc, glm::value_ptr(val), sizeof(val)))
+                    glUniform3fv(loc, 1, glm::value_ptr(val));
+            } else if constexpr (std::is_same_v<T, glm::vec4>) {
+                if (update_shadow(loc, glm::value_ptr(val), sizeof(val)))
+                    glUniform4fv(loc, 1, glm::value_ptr(val));
+            } else if constexpr (std::is_same_v<T, glm::mat2>) {
+                if (update_shadow(loc, glm::value_ptr(val), sizeof(val)))
+                    glUniformMatrix2fv(loc, 1, GL_FALSE, glm::value_ptr(val));
+            } else if constexpr (std::is_same_v<T, glm::mat3>) {
+                if (update_shadow(loc, glm::value_ptr(val), sizeof(val)))
+                    glUniformMatrix3fv(loc, 1, GL_FALSE, glm::value_ptr(val));
+            } else if constexpr (std::is_same_v<T, glm::mat4>) {
+                if (update_shadow(loc, glm::value_ptr(val), sizeof(val)))
+                    glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(val));
+            } else {
                 throw std::invalid_argument("Invalid argument for ShaderProgram::set_value");
+            }
         }
 
-        void set_value(GLint loc, float val_1, float val_2) const {
-            glUniform2f(loc, val_1, val_2);
+        void set_value(GLint loc, float val_1, float val_2) {
+            set_value(loc, glm::vec2(val_1, val_2));
         }
 
-        void set_value(GLint loc, float val_1, float val_2, float val_3) const {
-            glUniform3f(loc, val_1, val_2, val_3);
+        void set_value(GLint loc, float val_1, float val_2, float val_3) {
+            set_value(loc, glm::vec3(val_1, val_2, val_3));
         }
 
-        void set_value(GLint loc, float val_1, float val_2, float val_3, float val_4) const {
-            glUniform4f(loc, val_1, val_2, val_3, val_4);
+        void set_value(GLint loc, float val_1, float val_2, float val_3, float val_4) {
+            set_value(loc, glm::vec4(val_1, val_2, val_3, val_4));
         }
 
         template <typename ...Args>
-        void set_value(const std::string &name, Args &&...args) {
-            set_value(get_uniform_loc(name), std::forward<Args>(args)...);
+        void set_value(UniformId id, Args &&...args) {
+            set_value(get_uniform_loc(id), std::forward<Args>(args)...);
+        }
+
+        // Forgets the shadowed values, so the next set_value on each location reaches the driver
+        void invalidate_uniform_shadows() {
+            for (auto &shadow: this->uniform_shadows)
+                shadow.size = 0;
         }
 
+        // Counters shared by all programs, reset them once per frame to get per-frame figures
+        struct UniformStats {
+            std::size_t issued, elided;
+        };
+
+        static inline const UniformStats &get_uniform_stats() { return s_uniform_stats; }
+        static inline void reset_uniform_stats()               { s_uniform_stats = {}; }
+
         std::string get_log() const {
             std::string str(0x200, 0);
             glGetProgramInfoLog(get_handle(), str.size(), nullptr, (char *)str.data());
@@ -121,10 +231,127 @@ class ShaderProgram: public GlObject {
         }
 
     private:
-        struct Comp {
-            bool operator()(const std::string &s1, const std::string &s2) const {
-                return strcmp(s1.c_str(), s2.c_str()) < 0;
-            }
+        struct UniformSlot {
+            std::uint32_t hash; // 0 marks an empty slot
+            GLint loc;
+        };
+
+        struct UniformShadow {
+            std::uint8_t size; // 0 until a value was uploaded
+            alignas(4) std::uint8_t data[sizeof(glm::mat4)];
         };
-        std::map<std::string, GLint, Comp> uniform_loc_cache;
+
+        static constexpr std::uint32_t get_table_key(std::uint32_t hash) {
+            return hash ? hash : 1;
+        }
+
+        bool find_uniform(UniformId id, GLint &loc) const {
+            std::uint32_t key = get_table_key(id.get_hash());
+            std::size_t mask = this->uniform_table.size() - 1;
+            for (std::size_t i = key & mask;; i = (i + 1) & mask) {
+                auto &slot = this->uniform_table[i];
+                if (slot.hash == key)
+                    return loc = slot.loc, true;
+                if (!slot.hash)
+                    return false;
+            }
+        }
+
+        // Enumerates active uniforms (expanding arrays of basic types into one entry per element)
+        // into a power-of-two open-addressed table with a load factor of at most 1/2
+        void build_uniform_table() {
+            GLint nb_uniforms = 0, max_len = 0;
+            glGetProgramiv(get_handle(), GL_ACTIVE_UNIFORMS, &nb_uniforms);
+            glGetProgramiv(get_handle(), GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_len);
+
+            // Lookups compare hashes only, so two names sharing a key would silently alias: one must be renamed
+            std::map<std::uint32_t, std::string> names;
+            auto add = [this, &names](const std::string &name) {
+                GLint loc = glGetUniformLocation(get_handle(), name.c_str());
+                if (loc == -1) // Member of a uniform block
+                    return;
+                auto [it, inserted] = names.emplace(get_table_key(fnv1a_32(name)), name);
+                if (!inserted && (it->second != name)) {
+                    std::cout << "Uniform names " << it->second << " and " << name << " have the same hash\n";
+                    throw std::runtime_error("Uniform name hash collision");
+                }
+                if (inserted)
+                    this->uniform_locs.emplace_back(it->first, loc);
+            };
+
+            this->uniform_locs.clear();
+            std::string name(std::max(max_len, 1), 0);
+            for (GLint i = 0; i < nb_uniforms; ++i) {
+                GLsizei len;
+                GLint size;
+                GLenum type;
+                glGetActiveUniform(get_handle(), i, name.size(), &len, &size, &type, name.data());
+                std::string uniform(name.data(), len);
+
+                if ((uniform.size() > 3) && !uniform.compare(uniform.size() - 3, 3, "[0]")) {
+                    std::string base = uniform.substr(0, uniform.size() - 3);
+                    add(base);
+                    for (GLint j = 0; j < size; ++j)
+                        add(base + '[' + std::to_string(j) + ']');
+                } else {
+                    add(uniform);
+                }
+            }
+
+            std::size_t capacity = 16;
+            while (capacity < 2 * this->uniform_locs.size())
+                capacity *= 2;
+            rehash(capacity);
+
+            // Linking resets every uniform to its default, so nothing from before can be trusted
+            GLint max_loc = -1;
+            for (auto &[key, loc]: this->uniform_locs)
+                max_loc = std::max(max_loc, loc);
+            this->uniform_shadows.assign(max_loc + 1, {});
+        }
+
+        // Records the value about to be uploaded at loc, returns false if it's already the current one
+        bool update_shadow(GLint loc, const void *data, std::size_t size) {
+            if (loc < 0)
+                return false;
+            if ((std::size_t)loc < this->uniform_shadows.size()) {
+                auto &shadow = this->uniform_shadows[loc];
+                if ((shadow.size == size) && !std::memcmp(shadow.data, data, size)) {
+                    ++s_uniform_stats.elided;
+                    return false;
+                }
+                shadow.size = size;
+                std::memcpy(shadow.data, data, size);
+            }
+            ++s_uniform_stats.issued;
+            return true;
+        }
+
+        void rehash(std::size_t capacity) {
+            this->uniform_table.assign(capacity, {0, -1});
+            for (auto &[key, loc]: this->uniform_locs) {
+                std::size_t mask = capacity - 1, i = key & mask;
+                while (this->uniform_table[i].hash)
+                    i = (i + 1) & mask;
+                this->uniform_table[i] = {key, loc};
+            }
+        }
+
+        void insert_uniform(std::uint32_t key, GLint loc) {
+            this->uniform_locs.emplace_back(key, loc);
+            if (2 * this->uniform_locs.size() > this->uniform_table.size())
+                return rehash(2 * this->uniform_table.size());
+
+            std::size_t mask = this->uniform_table.size() - 1, i = key & mask;
+            while (this->uniform_table[i].hash)
+                i = (i + 1) & mask;
+            this->uniform_table[i] = {key, loc};
+        }
+
+    protected:
+        std::vector<std::pair<std::uint32_t, GLint>> uniform_locs;
+        std::vector<UniformSlot> uniform_table = std::vector<UniformSlot>(16, {0, -1});
+        std::vector<UniformShadow> uniform_shadows;
+
+        static inline UniformStats s_uniform_stats;
 };
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <stdexcept>
 #include <algorithm>
 #include <tuple>
@@ -8,6 +9,7 @@
 #include <stb_image.h>
 
 #include "object.hpp"
+#include "gl_state.hpp"
 
 enum class TextureType {
     Diffuse,
@@ -15,64 +17,161 @@ enum class TextureType {
     Normal,
 };
 
+// Edits go through DSA when the context has it (see GlState), otherwise the texture is bound to a unit
+// reserved for edits (GlState::edit_texture_unit), so the units used for drawing are left alone
+// With DSA, set_data allocates immutable storage (with a full mip chain) when given level 0, and uploads into it
+// Immutable storage can't be respecified: level 0 with other dimensions or format moves the texture to a new handle
 template <GLenum Type, std::size_t N = 1>
 class Texture: public GlObject {
     public:
         Texture() {
-            glGenTextures(get_nb(), &this->handle);
+            if (GlState::has_dsa())
+                glCreateTextures(get_type(), get_nb(), &this->handle);
+            else
+                glGenTextures(get_nb(), &this->handle);
             if (!get_handle())
                 throw std::runtime_error("Could not create texture");
-            bind();
         }
 
-        Texture(int idx) {
-            if (idx >= 0) this->active(idx);
-            glGenTextures(get_nb(), &this->handle);
-            if (!get_handle())
-                throw std::runtime_error("Could not create texture");
-            bind();
+        // Also binds the texture to unit idx, unless negative
+        Texture(int idx): Texture() {
+            if (idx >= 0)
+                bind_unit(idx);
         }
 
         ~Texture() {
+            GlState::forget_texture(get_handle());
             glDeleteTextures(get_nb(), &this->handle);
         }
 
         static void active(GLuint idx) {
-            glActiveTexture(GL_TEXTURE0 + idx);
+            GlState::active_texture(idx);
         }
 
         static void deactive(GLuint idx) {
-            glActiveTexture(GL_TEXTURE0);
+            active(0);
         }
 
-        static void generate_mipmap() {
-            glGenerateMipmap(get_type());
+        void generate_mipmap() const {
+            if (GlState::has_dsa())
+                glGenerateTextureMipmap(get_handle());
+            else
+                bind_for_edit(), glGenerateMipmap(get_type());
         }
 
         template <typename ...Params>
-        static void set_parameters(Params &&...params) {
-            (glTexParameteri(get_type(), params.first, params.second), ...);
+        void set_parameters(Params &&...params) const {
+            if (GlState::has_dsa())
+                (glTextureParameteri(get_handle(), params.first, params.second), ...);
+            else
+                bind_for_edit(), (glTexParameteri(get_type(), params.first, params.second), ...);
         }
 
-        static void set_default_parameters() {
+        void set_default_parameters() const {
             set_parameters(std::pair{GL_TEXTURE_WRAP_S, GL_REPEAT}, std::pair{GL_TEXTURE_WRAP_T, GL_REPEAT},
                 std::pair{GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR}, std::pair{GL_TEXTURE_MAG_FILTER, GL_LINEAR});
         }
 
+        // Binds to the active unit
         void bind() const {
-            glBindTexture(get_type(), get_handle());
+            bind(get_handle());
         }
 
         static void bind(GLuint handle) {
-            glBindTexture(get_type(), handle);
+            GlState::bind_texture(get_type(), handle);
         }
 
         static void unbind() {
-            glBindTexture(get_type(), 0);
+            bind(0);
+        }
+
+        void bind_unit(GLuint unit) const {
+            bind_unit(unit, get_handle());
+        }
+
+        // Without DSA, leaves unit active
+        static void bind_unit(GLuint unit, GLuint handle) {
+            GlState::bind_texture_unit(unit, get_type(), handle);
         }
 
         static inline std::size_t get_nb()   { return N; }
         static inline GLenum      get_type() { return Type; }
+
+    protected:
+        GLenum storage_fmt = 0;
+        GLsizei storage_dims[3] = {};
+
+        void bind_for_edit() const {
+            GlState::active_texture(GlState::edit_texture_unit);
+            bind();
+        }
+
+        // Unsized formats are given the precision of the data they are loaded from
+        static GLenum get_sized_format(GLenum store_fmt, GLenum load_data_fmt) {
+            std::size_t i = (load_data_fmt == GL_FLOAT) ? 2 : (load_data_fmt == GL_UNSIGNED_SHORT) ? 1 : 0;
+            switch (store_fmt) {
+                case GL_RED:             return std::array{GL_R8,    GL_R16,    GL_R32F}[i];
+                case GL_RG:              return std::array{GL_RG8,   GL_RG16,   GL_RG32F}[i];
+                case GL_RGB:             return std::array{GL_RGB8,  GL_RGB16,  GL_RGB32F}[i];
+                case GL_RGBA:            return std::array{GL_RGBA8, GL_RGBA16, GL_RGBA32F}[i];
+                case GL_DEPTH_COMPONENT: return (i == 2) ? GL_DEPTH_COMPONENT32F : GL_DEPTH_COMPONENT24;
+                case GL_DEPTH_STENCIL:   return GL_DEPTH24_STENCIL8;
+                default:                 return store_fmt;
+            }
+        }
+
+        // Without data, nothing is read unless a pixel unpack buffer is bound (data is then an offset into it)
+        static bool has_source(const void *data) {
+            if (data)
+                return true;
+            GLint pbo;
+            glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &pbo);
+            return pbo;
+        }
+
+        // DSA only, level 0 dimensions (1 for the ones the type doesn't have)
+        void set_storage(GLenum store_fmt, GLenum load_data_fmt, GLsizei width, GLsizei height, GLsizei depth) {
+            GLenum fmt = get_sized_format(store_fmt, load_data_fmt);
+            if (this->storage_fmt) {
+                if ((fmt == this->storage_fmt) && (width == this->storage_dims[0])
+                        && (height == this->storage_dims[1]) && (depth == this->storage_dims[2]))
+                    return;
+                recreate();
+            }
+
+            GLsizei nb_levels = 1;
+            for (GLsizei size = std::max({width, height, depth}); size >>= 1; ++nb_levels);
+            if constexpr (Type == GL_TEXTURE_1D)
+                glTextureStorage1D(get_handle(), nb_levels, fmt, width);
+            else if constexpr (Type == GL_TEXTURE_3D)
+                glTextureStorage3D(get_handle(), nb_levels, fmt, width, height, depth);
+            else
+                glTextureStorage2D(get_handle(), nb_levels, fmt, width, height);
+            this->storage_fmt = fmt, this->storage_dims[0] = width, this->storage_dims[1] = height, this->storage_dims[2] = depth;
+        }
+
+        // Moves to a new texture, carrying over the sampling parameters and the units the old one is bound to
+        void recreate() {
+            GLuint old_handle = get_handle();
+            glCreateTextures(get_type(), get_nb(), &this->handle);
+            if (!get_handle())
+                throw std::runtime_error("Could not create texture");
+
+            for (GLenum param: { GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER, GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_WRAP_R }) {
+                GLint val;
+                glGetTextureParameteriv(old_handle, param, &val);
+                glTextureParameteri(get_handle(), param, val);
+            }
+            GlState::replace_texture(get_type(), old_handle, get_handle());
+            GlState::forget_texture(old_handle);
+            glDeleteTextures(get_nb(), &old_handle);
+            this->storage_fmt = 0;
+        }
+
+        void check_storage() const {
+            if (!this->storage_fmt)
+                throw std::runtime_error("Texture level 0 must be specified first");
+        }
 };
 
 template <std::size_t N = 1>
@@ -83,7 +182,17 @@ class Texture1d: public Texture<GL_TEXTURE_1D, N> {
 
         void set_data(void *data, GLuint width, GLuint mipmap_lvl = 0,
                 GLenum store_fmt = GL_RGB, GLenum load_fmt = GL_RGB, GLenum load_data_fmt = GL_UNSIGNED_BYTE, GLuint leg = 0) {
-            glTexImage1D(this->get_type(), mipmap_lvl, store_fmt, width, leg, load_fmt, load_data_fmt, data);
+            if (!GlState::has_dsa()) {
+                this->bind_for_edit();
+                glTexImage1D(this->get_type(), mipmap_lvl, store_fmt, width, leg, load_fmt, load_data_fmt, data);
+                return;
+            }
+
+            if (!mipmap_lvl)
+                this->set_storage(store_fmt, load_data_fmt, width, 1, 1);
+            this->check_storage();
+            if (this->has_source(data))
+                glTextureSubImage1D(this->get_handle(), mipmap_lvl, 0, width, load_fmt, load_data_fmt, data);
         }
 };
 
@@ -115,8 +224,29 @@ class Texture2d: public Texture<GL_TEXTURE_2D, N> {
 
         void set_data(void *data, GLuint width, GLuint height, GLenum store_fmt = GL_RGB, GLenum load_fmt = GL_RGB,
                 GLenum load_data_fmt = GL_UNSIGNED_BYTE, GLuint mipmap_lvl = 0, GLuint leg = 0) {
-            glTexImage2D(this->get_type(), mipmap_lvl, store_fmt, width, height, leg, load_fmt, load_data_fmt, data);
+            if (!mipmap_lvl)
+                this->width = width, this->height = height, this->store_fmt = store_fmt;
+
+            if (!GlState::has_dsa()) {
+                this->bind_for_edit();
+                glTexImage2D(this->get_type(), mipmap_lvl, store_fmt, width, height, leg, load_fmt, load_data_fmt, data);
+                return;
+            }
+
+            if (!mipmap_lvl)
+                this->set_storage(store_fmt, load_data_fmt, width, height, 1);
+            this->check_storage();
+            if (this->has_source(data))
+                glTextureSubImage2D(this->get_handle(), mipmap_lvl, 0, 0, width, height, load_fmt, load_data_fmt, data);
         }
+
+        inline GLuint get_width()     const { return this->width; }
+        inline GLuint get_height()    const { return this->height; }
+        inline GLenum get_store_fmt() const { return this->store_fmt; }
+
+    protected:
+        GLuint width = 0, height = 0;
+        GLenum store_fmt = 0;
 };
 
 template <std::size_t N = 1>
@@ -127,6 +257,16 @@ class Texture3d: public Texture<GL_TEXTURE_3D, N> {
 
         void set_data(void *data, GLuint width, GLuint height, GLuint depth, GLuint mipmap_lvl = 0,
                 GLenum store_fmt = GL_RGB, GLenum load_fmt = GL_RGB, GLenum load_data_fmt = GL_UNSIGNED_BYTE, GLuint leg = 0) {
-            glTexImage3D(this->get_type(), mipmap_lvl, store_fmt, width, height, depth, leg, load_fmt, load_data_fmt, data);
+            if (!GlState::has_dsa()) {
+                this->bind_for_edit();
+                glTexImage3D(this->get_type(), mipmap_lvl, store_fmt, width, height, depth, leg, load_fmt, load_data_fmt, data);
+                return;
+            }
+
+            if (!mipmap_lvl)
+                this->set_storage(store_fmt, load_data_fmt, width, height, depth);
+            this->check_storage();
+            if (this->has_source(data))
+                glTextureSubImage3D(this->get_handle(), mipmap_lvl, 0, 0, 0, width, height, depth, load_fmt, load_data_fmt, data);
         }
 };
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <map>
+#include <memory>
+#include <utility>
+#include <filesystem>
+#include <glad/glad.h>
+
+#include "texture.hpp"
+
+// Process-wide cache of 2d textures loaded from files
+// Handles are reference-counted: a texture stays resident as long as one of them is alive,
+// and is decoded/uploaded again only if requested after every handle was released
+class TextureCache {
+    public:
+        using Handle = std::shared_ptr<Texture2d<>>;
+
+        struct Stats {
+            std::size_t hits, misses;
+            std::size_t nb_resident, resident_bytes;
+        };
+
+        static Handle get(const std::string &path, GLenum load_data_fmt = GL_UNSIGNED_BYTE) {
+            Key key = {resolve(path), load_data_fmt};
+
+            auto it = s_entries.find(key);
+            if (it != s_entries.end()) {
+                if (Handle handle = it->second.lock()) {
+                    ++s_stats.hits;
+                    return handle;
+                }
+            }
+
+            ++s_stats.misses;
+            auto *tex = new Texture2d<>(key.first, -1, load_data_fmt);
+            std::size_t size = get_size_estimate(*tex);
+            s_stats.resident_bytes += size, ++s_stats.nb_resident;
+
+            Handle handle(tex, [size](Texture2d<> *tex) {
+                s_stats.resident_bytes -= size, --s_stats.nb_resident;
+                delete tex;
+            });
+            s_entries[std::move(key)] = handle;
+            return handle;
+        }
+
+        // Forgets entries whose texture was released
+        static void purge() {
+            for (auto it = s_entries.begin(); it != s_entries.end();) {
+                if (it->second.expired())
+                    it = s_entries.erase(it);
+                else
+                    ++it;
+            }
+        }
+
+        static inline const Stats &get_stats() { return s_stats; }
+        static inline void reset_counters()    { s_stats.hits = s_stats.misses = 0; }
+
+    private:
+        using Key = std::pair<std::string, GLenum>;
+
+        static std::string resolve(const std::string &path) {
+            std::error_code ec;
+            auto resolved = std::filesystem::weakly_canonical(path, ec);
+            return ec ? path : resolved.string();
+        }
+
+        // Base level plus a full mip chain (~1/3 extra)
+        static std::size_t get_size_estimate(const Texture2d<> &tex) {
+            std::size_t bpp;
+            switch (tex.get_store_fmt()) {
+                case GL_RGBA: bpp = 4; break;
+                case GL_RGB:  bpp = 3; break;
+                case GL_RG:   bpp = 2; break;
+                default:      bpp = 1; break;
+            }
+            return (std::size_t)tex.get_width() * tex.get_height() * bpp * 4 / 3;
+        }
+
+    protected:
+        static inline std::map<Key, std::weak_ptr<Texture2d<>>> s_entries;
+        static inline Stats s_stats;
+};
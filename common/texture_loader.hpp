@@ -0,0 +1,217 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <deque>
+#include <memory>
+#include <future>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include "texture.hpp"
+#include "buffer.hpp"
+#include "thread_pool.hpp"
+
+// Streams 2d textures in without blocking the render thread:
+// files are decoded on a thread pool, then copied through a pixel unpack buffer in chunks,
+// with the per-frame work in update() kept under a time budget
+// Handles returned by load() are usable right away and show a 1x1 placeholder until their upload completes
+class TextureLoader {
+    public:
+        using Handle = std::shared_ptr<Texture2d<>>;
+
+        TextureLoader(ThreadPool &pool, double budget_ms = 2.0, std::size_t chunk_size = 0x40000):
+                pool(pool), budget_ms(budget_ms), chunk_size(chunk_size) {
+            stbi_set_flip_vertically_on_load(true);
+            this->pbo.unbind();
+        }
+
+        ~TextureLoader() {
+            for (auto &req: this->pending)
+                stbi_image_free(req.image.get().data);
+            if (this->upload.tex) {
+                this->pbo.unmap();
+                stbi_image_free(this->upload.image.data);
+            }
+        }
+
+        // load_data_fmt picks the decoded component type: GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_FLOAT
+        Handle load(const std::string &path, GLint idx = -1, GLenum load_data_fmt = GL_UNSIGNED_BYTE) {
+            if (!get_component_size(load_data_fmt))
+                throw std::runtime_error("Unsupported texture load format");
+
+            static constexpr std::uint8_t placeholder[] = { 0x80, 0x80, 0x80, 0xff };
+
+            auto tex = std::make_shared<Texture2d<>>(idx);
+            tex->set_data((void *)placeholder, 1, 1, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE);
+            tex->set_default_parameters();
+
+            this->pending.push_back({tex, load_data_fmt, this->pool.submit([path, load_data_fmt] { return decode(path, load_data_fmt); })});
+            return tex;
+        }
+
+        // Must be called from the context thread, typically once per frame
+        // Returns the number of textures whose upload completed
+        std::size_t update() {
+            auto start = Clock::now();
+            auto elapsed_ms = [&start] { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+            std::size_t nb_completed = 0;
+            bool pbo_bound = false, did_work = false;
+            while (elapsed_ms() < this->budget_ms) {
+                if (!this->upload.tex && !begin_upload())
+                    break;
+
+                if (!pbo_bound)
+                    this->pbo.bind(), pbo_bound = true;
+                if (!this->upload.map && !map_upload())
+                    break;
+
+                std::size_t len = std::min(this->chunk_size, this->upload.size - this->upload.copied);
+                std::memcpy((std::uint8_t *)this->upload.map + this->upload.copied, this->upload.image.data + this->upload.copied, len);
+                this->upload.copied += len;
+                did_work |= len != 0;
+
+                if (this->upload.copied < this->upload.size)
+                    continue;
+
+                // Specifying the texture and building its mip chain can't be split,
+                // so defer it to the start of the next frame if it would likely overrun this one
+                double spent = elapsed_ms();
+                if (did_work && (spent + this->finalize_cost_ms > this->budget_ms))
+                    break;
+
+                finalize_upload();
+                this->finalize_cost_ms = 0.75 * this->finalize_cost_ms + 0.25 * (elapsed_ms() - spent);
+                ++nb_completed, did_work = true;
+            }
+
+            if (pbo_bound)
+                this->pbo.unbind();
+            return nb_completed;
+        }
+
+        inline bool is_idle() const { return this->pending.empty() && !this->upload.tex; }
+
+        inline void   set_budget(double budget_ms) { this->budget_ms = budget_ms; }
+        inline double get_budget() const           { return this->budget_ms; }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Image {
+            stbi_uc *data;
+            int w, h, nchan;
+        };
+
+        struct Request {
+            std::weak_ptr<Texture2d<>> tex;
+            GLenum load_data_fmt;
+            std::future<Image> image;
+        };
+
+        struct Upload {
+            Handle tex;
+            GLenum load_data_fmt;
+            Image image;
+            void *map;
+            std::size_t size, copied;
+        };
+
+        static std::size_t get_component_size(GLenum load_data_fmt) {
+            switch (load_data_fmt) {
+                case GL_UNSIGNED_BYTE:  return sizeof(stbi_uc);
+                case GL_UNSIGNED_SHORT: return sizeof(stbi_us);
+                case GL_FLOAT:          return sizeof(float);
+                default:                return 0;
+            }
+        }
+
+        static Image decode(const std::string &path, GLenum load_data_fmt) {
+            Image image;
+            if (load_data_fmt == GL_UNSIGNED_SHORT)
+                image.data = (stbi_uc *)stbi_load_16(path.c_str(), &image.w, &image.h, &image.nchan, 0);
+            else if (load_data_fmt == GL_FLOAT)
+                image.data = (stbi_uc *)stbi_loadf(path.c_str(), &image.w, &image.h, &image.nchan, 0);
+            else
+                image.data = stbi_load(path.c_str(), &image.w, &image.h, &image.nchan, 0);
+            if (!image.data)
+                std::cout << "Could not load texture file " << path << ": " << stbi_failure_reason() << '\n';
+            return image;
+        }
+
+        bool begin_upload() {
+            // Uploads complete in request order so the first textures asked for show up first
+            while (!this->pending.empty()) {
+                auto &req = this->pending.front();
+                if (req.image.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                    return false;
+
+                Image image = req.image.get();
+                Handle tex = req.tex.lock();
+                GLenum load_data_fmt = req.load_data_fmt;
+                this->pending.pop_front();
+
+                if (!image.data)
+                    continue;
+                if (!tex) {
+                    stbi_image_free(image.data);
+                    continue;
+                }
+
+                std::size_t size = (std::size_t)image.w * image.h * image.nchan * get_component_size(load_data_fmt);
+                this->upload = { std::move(tex), load_data_fmt, image, nullptr, size, 0 };
+                return true;
+            }
+            return false;
+        }
+
+        bool map_upload() {
+            this->pbo.set_data(nullptr, this->upload.size, GL_STREAM_DRAW);
+            this->upload.map = this->pbo.map(0, this->upload.size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            if (!this->upload.map) {
+                std::cout << "Could not map texture staging buffer\n";
+                stbi_image_free(this->upload.image.data);
+                this->upload = {};
+                return false;
+            }
+            return true;
+        }
+
+        void finalize_upload() {
+            auto &[tex, load_data_fmt, image, map, size, copied] = this->upload;
+            this->pbo.unmap();
+
+            GLenum fmt;
+            if      (image.nchan == 3) fmt = GL_RGB;
+            else if (image.nchan == 4) fmt = GL_RGBA;
+            else                       fmt = GL_RED;
+
+            // Leave the unpack state as the application set it (texture edits don't touch the units used for drawing)
+            GLint prev_align;
+            glGetIntegerv(GL_UNPACK_ALIGNMENT, &prev_align);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+            tex->set_data(nullptr, image.w, image.h, fmt, fmt, load_data_fmt);
+            tex->generate_mipmap();
+
+            glPixelStorei(GL_UNPACK_ALIGNMENT, prev_align);
+
+            stbi_image_free(image.data);
+            this->upload = {};
+        }
+
+    protected:
+        ThreadPool &pool;
+        double budget_ms, finalize_cost_ms = 0.0;
+        std::size_t chunk_size;
+
+        PixelUnpackBuffer<> pbo;
+        std::deque<Request> pending;
+        Upload upload = {};
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <exception>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <type_traits>
+#include <algorithm>
+
+class ThreadPool {
+    public:
+        ThreadPool(std::size_t nb_threads = std::max(std::thread::hardware_concurrency(), 1u)) {
+            this->workers.reserve(nb_threads);
+            for (std::size_t i = 0; i < nb_threads; ++i)
+                this->workers.emplace_back([this] { worker_main(); });
+        }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard lk(this->mtx);
+                this->stopping = true;
+            }
+            this->cv.notify_all();
+            for (auto &worker: this->workers)
+                worker.join();
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        template <typename F>
+        auto submit(F &&fn) -> std::future<std::invoke_result_t<F>> {
+            auto task = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(fn));
+            auto fut = task->get_future();
+            {
+                std::lock_guard lk(this->mtx);
+                this->tasks.emplace_back([task] { (*task)(); });
+            }
+            this->cv.notify_one();
+            return fut;
+        }
+
+        // Runs fn(i) for i in [0, n), distributing indices dynamically, and blocks until all are done
+        // The calling thread takes part in the work, so this is safe to call with a busy pool
+        template <typename F>
+        void parallel_for(std::size_t n, F &&fn) {
+            if (!n)
+                return;
+
+            std::atomic_size_t next = 0;
+            auto run = [&] {
+                for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < n;)
+                    fn(i);
+            };
+
+            std::vector<std::future<void>> futs;
+            std::size_t nb_helpers = std::min(get_nb_threads(), n - 1);
+            futs.reserve(nb_helpers);
+            for (std::size_t i = 0; i < nb_helpers; ++i)
+                futs.push_back(submit(run));
+
+            // Helpers hold references to this frame, so they must all be joined even if a task throws
+            std::exception_ptr err;
+            try {
+                run();
+            } catch (...) {
+                err = std::current_exception();
+                next = n;
+            }
+            for (auto &fut: futs) {
+                try {
+                    fut.get();
+                } catch (...) {
+                    if (!err) err = std::current_exception();
+                }
+            }
+            if (err)
+                std::rethrow_exception(err);
+        }
+
+        inline std::size_t get_nb_threads() const { return this->workers.size(); }
+
+    private:
+        void worker_main() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock lk(this->mtx);
+                    this->cv.wait(lk, [this] { return this->stopping || !this->tasks.empty(); });
+                    if (this->stopping && this->tasks.empty())
+                        return;
+                    task = std::move(this->tasks.front());
+                    this->tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+    protected:
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> tasks;
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool stopping = false;
+};
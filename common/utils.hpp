@@ -1,8 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <utility>
 #include <functional>
 #include <type_traits>
+#include <string_view>
 
 #define _STRINGIFY(x)      #x
 #define  STRINGIFY(x)      _STRINGIFY(x)
@@ -16,6 +18,18 @@
 #define ASSERT_SIZE(x, sz)        static_assert(sizeof(x) == sz, "Wrong size in " STRINGIFY(x))
 #define ASSERT_STANDARD_LAYOUT(x) static_assert(std::is_standard_layout_v<x>, STRINGIFY(x) " is not standard layout")
 
+constexpr std::uint32_t fnv1a_32(std::string_view str, std::uint32_t hash = 0x811c9dc5) {
+    for (char c: str)
+        hash = (hash ^ (std::uint8_t)c) * 0x01000193;
+    return hash;
+}
+
+constexpr std::uint64_t fnv1a_64(std::string_view str, std::uint64_t hash = 0xcbf29ce484222325) {
+    for (char c: str)
+        hash = (hash ^ (std::uint8_t)c) * 0x100000001b3;
+    return hash;
+}
+
 template <typename T>
 struct Position {
     constexpr Position() = default;
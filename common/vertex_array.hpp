@@ -1,31 +1,87 @@
 #pragma once
 
+#include <cstdint>
 #include <glad/glad.h>
 
 #include "object.hpp"
+#include "gl_state.hpp"
+#include "buffer.hpp"
 
+// With DSA (see GlState), vertex streams are specified by name (ARB_vertex_attrib_binding) and nothing is bound:
+// each stream gets the buffer binding numbered after its first attribute, so re-pointing it is a single call
+// Without DSA, they are specified on the bound vertex array and GL_ARRAY_BUFFER (see VertexBuffer::set_layout)
 template <std::size_t N = 1>
 class VertexArray: public GlObject {
     public:
+        // Without DSA, the name only becomes a vertex array once bound
         VertexArray() {
-            glGenVertexArrays(get_nb(), &this->handle);
-            bind();
+            if (GlState::has_dsa()) {
+                glCreateVertexArrays(get_nb(), &this->handle);
+            } else {
+                glGenVertexArrays(get_nb(), &this->handle);
+                bind();
+            }
         }
 
         ~VertexArray() {
+            GlState::forget_vertex_array(get_handle());
             glDeleteVertexArrays(get_nb(), &this->handle);
         }
 
+        // Specifies the attributes of a stream read from buffer, base_off bytes in (eg. the current region of a StreamBuffer)
+        // Streams sharing the vertex array are laid out one after the other, starting at first_attrib
+        // Returns the first attribute index past this layout
+        // Without DSA, leaves the vertex array and the buffer bound
+        GLuint set_layout(BufferLayout &&layout, const GlObject &buffer, GLuint first_attrib = 0, std::uintptr_t base_off = 0) const {
+            if (!GlState::has_dsa()) {
+                bind();
+                GlState::bind_buffer(GL_ARRAY_BUFFER, buffer.get_handle());
+                return VertexBuffer<>::set_layout(std::move(layout), first_attrib, base_off);
+            }
+
+            GLuint i = first_attrib, off = 0;
+            for (auto &element: layout.elements) {
+                std::size_t nb = element.nb / element.nb_attribs, size = element.size / element.nb_attribs;
+                for (std::size_t j = 0; j < element.nb_attribs; ++j) {
+                    glEnableVertexArrayAttrib(get_handle(), i);
+                    glVertexArrayAttribFormat(get_handle(), i, nb, element.gl_type, element.normalized, off);
+                    glVertexArrayAttribBinding(get_handle(), i, first_attrib);
+                    off += size; ++i;
+                }
+            }
+            glVertexArrayBindingDivisor(get_handle(), first_attrib, layout.divisor);
+            glVertexArrayVertexBuffer(get_handle(), first_attrib, buffer.get_handle(), base_off, layout.stride);
+            return i;
+        }
+
+        // Points a stream specified by set_layout at base_off of buffer: with DSA, only its buffer binding changes
+        GLuint set_vertex_buffer(BufferLayout &&layout, const GlObject &buffer, GLuint first_attrib = 0, std::uintptr_t base_off = 0) const {
+            if (!GlState::has_dsa())
+                return set_layout(std::move(layout), buffer, first_attrib, base_off);
+            glVertexArrayVertexBuffer(get_handle(), first_attrib, buffer.get_handle(), base_off, layout.stride);
+            return first_attrib + layout.get_nb_attribs();
+        }
+
+        // Without DSA, leaves the vertex array bound
+        void set_element_buffer(const GlObject &buffer) const {
+            if (GlState::has_dsa()) {
+                glVertexArrayElementBuffer(get_handle(), buffer.get_handle());
+            } else {
+                bind();
+                GlState::bind_buffer(GL_ELEMENT_ARRAY_BUFFER, buffer.get_handle());
+            }
+        }
+
         void bind() const {
-            glBindVertexArray(get_handle());
+            bind(get_handle());
         }
 
         static void bind(GLuint handle) {
-            glBindVertexArray(handle);
+            GlState::bind_vertex_array(handle);
         }
 
         static void unbind() {
-            glBindVertexArray(0);
+            bind(0);
         }
 
         static inline std::size_t get_nb() { return N; }
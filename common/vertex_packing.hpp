@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+// Conversions to the compact attribute formats understood by BufferElement (Half*, Short*, Packed4)
+// The snorm encodings round to the nearest of 2^(b-1)-1 steps, as GL 4.2+ decodes them;
+// GL 3.3 uses (2c + 1) / (2^b - 1) instead, which is off by less than one step
+
+// IEEE 754 binary16, rounded to nearest, overflowing to infinity
+inline std::uint16_t pack_half(float val) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    std::uint32_t sign = (bits >> 16) & 0x8000, mant = bits & 0x7fffff;
+    std::int32_t  exp  = (std::int32_t)((bits >> 23) & 0xff) - 127 + 15;
+
+    if (((bits >> 23) & 0xff) == 0xff)                  // Infinity, NaN
+        return sign | 0x7c00 | (mant ? 0x200 : 0);
+    if (exp >= 0x1f)                                    // Too large
+        return sign | 0x7c00;
+    if (exp <= 0) {                                     // Subnormal, or too small
+        if (exp < -10)
+            return sign;
+        mant |= 0x800000;
+        std::uint32_t shift = 14 - exp;
+        return sign | ((mant >> shift) + ((mant >> (shift - 1)) & 1));
+    }
+    // A carry out of the mantissa correctly bumps the exponent
+    return (sign | (exp << 10) | (mant >> 13)) + ((mant >> 12) & 1);
+}
+
+inline std::int16_t pack_snorm16(float val) {
+    return (std::int16_t)std::round(std::clamp(val, -1.0f, 1.0f) * 32767.0f);
+}
+
+// GL_INT_2_10_10_10_REV: x in the low bits, w in the top 2
+inline std::uint32_t pack_snorm_2_10_10_10(float x, float y, float z, float w = 0.0f) {
+    auto pack = [](float val, float max, std::uint32_t mask) {
+        return (std::uint32_t)(std::int32_t)std::round(std::clamp(val, -1.0f, 1.0f) * max) & mask;
+    };
+    return pack(x, 511.0f, 0x3ff) | (pack(y, 511.0f, 0x3ff) << 10) | (pack(z, 511.0f, 0x3ff) << 20) | (pack(w, 1.0f, 0x3) << 30);
+}
@@ -1,20 +1,44 @@
 #pragma once
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <vector>
 #include <initializer_list>
 #include <algorithm>
 #include <stdexcept>
+#include <iostream>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "gl_state.hpp"
 
 struct GlVersion {
     int maj, min, profile;
 };
 
+// Without a display (or with LOGL_HEADLESS=1), windows are backed by a surfaceless EGL context
+// (llvmpipe on machines without a GPU) rendering into an offscreen framebuffer, so that demos
+// and benchmarks run unchanged in batch. In that mode:
+//   LOGL_HEADLESS_FRAMES bounds the number of frames before get_should_close() returns true (default 300)
+//   LOGL_HEADLESS_DUMP   names a PPM file receiving the last frame
+// LOGL_GL_VERSION (eg. 4.5) overrides the context version asked for, which also selects how GL objects
+// are edited (see GlState)
 class Window {
     public:
         Window(int w, int h, const char *name, int x = 0, int y = 0, GLboolean resizable = GL_TRUE,
-                GlVersion ver = {3, 3, GLFW_OPENGL_CORE_PROFILE}) {
-            set_gl_version(ver);
+                GlVersion ver = {3, 3, GLFW_OPENGL_CORE_PROFILE}): w(w), h(h), ver(get_requested_version(ver)) {
+            if (is_headless()) {
+                create_headless_ctx(this->ver);
+                this->max_frames = get_headless_frames();
+                return;
+            }
+
+            set_gl_version(this->ver);
             hint(std::pair{GLFW_RESIZABLE, resizable});
             if (!(this->window = glfwCreateWindow(w, h, name, nullptr, nullptr)))
                 throw std::runtime_error("Could not create window");
@@ -24,11 +48,71 @@ class Window {
         }
 
         ~Window() {
-            glfwDestroyWindow(get_window());
+            if (!is_headless()) {
+                glfwDestroyWindow(get_window());
+                return;
+            }
+
+            if (this->fbo) {
+                glDeleteFramebuffers(1, &this->fbo);
+                glDeleteRenderbuffers(2, this->rbos);
+            }
+            eglMakeCurrent(this->egl_dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            eglDestroyContext(this->egl_dpy, this->egl_ctx);
+            eglTerminate(this->egl_dpy);
+        }
+
+        static bool is_headless() {
+            if (s_headless < 0) {
+                const char *env = std::getenv("LOGL_HEADLESS");
+                s_headless = env ? (env[0] && (env[0] != '0')) : (!std::getenv("DISPLAY") && !std::getenv("WAYLAND_DISPLAY"));
+            }
+            return s_headless;
+        }
+
+        // Must be called before the first window is created
+        static void set_headless(bool val) { s_headless = val; }
+
+        // Loads GL entry points for the current context, and sets up the offscreen framebuffer when headless
+        // DSA is used from then on if the context was asked for GL 4.5 or later, and has it
+        bool load_gl() {
+            if (!gladLoadGLLoader(get_proc_loader()))
+                return false;
+            GlState::init(this->ver.maj, this->ver.min);
+            if (is_headless())
+                create_framebuffer();
+            return true;
+        }
+
+        static GLADloadproc get_proc_loader() {
+            return is_headless() ? (GLADloadproc)eglGetProcAddress : (GLADloadproc)glfwGetProcAddress;
+        }
+
+        // Seconds since initialization, or simulated time when a fixed timestep is set
+        static double get_time() {
+            if (s_timestep > 0.0)
+                return s_fixed_time;
+            if (!is_headless())
+                return glfwGetTime();
+            static auto start = std::chrono::steady_clock::now();
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        // Makes get_time() advance by exactly dt on every swap, for reproducible runs (0 restores wall time)
+        static void set_fixed_timestep(double dt) {
+            s_timestep = dt, s_fixed_time = 0.0;
         }
 
+        // get_should_close() returns true once this many frames were presented (0 for no limit)
+        inline void        set_max_frames(std::size_t n) { this->max_frames = n; }
+        inline std::size_t get_max_frames() const       { return this->max_frames; }
+        inline std::size_t get_nb_frames()  const       { return this->nb_frames; }
+
         void make_ctx_current() const {
-            glfwMakeContextCurrent(get_window());
+            if (is_headless())
+                eglMakeCurrent(this->egl_dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, this->egl_ctx);
+            else
+                glfwMakeContextCurrent(get_window());
         }
 
         static void set_gl_version(GlVersion ver) {
@@ -38,7 +122,8 @@ class Window {
 
         template <typename ...Hints>
         static void hint(Hints &&...hints) {
-            (glfwWindowHint(hints.first, hints.second), ...);
+            if (!is_headless())
+                (glfwWindowHint(hints.first, hints.second), ...);
         }
 
         static void set_viewport(int w, int h, int x = 0, int y = 0) {
@@ -46,50 +131,194 @@ class Window {
         }
 
         static void poll_events() {
-            glfwPollEvents();
+            if (!is_headless())
+                glfwPollEvents();
         }
 
-        void swap_buffers() const {
-            glfwSwapBuffers(get_window());
+        void swap_buffers() {
+            if (is_headless())
+                glFlush();
+            else
+                glfwSwapBuffers(get_window());
+
+            s_fixed_time += s_timestep;
+            if ((++this->nb_frames < this->max_frames) || !this->max_frames)
+                return;
+            if (const char *path = std::getenv("LOGL_HEADLESS_DUMP"); path && is_headless())
+                dump_framebuffer(path);
+            set_should_close(true);
         }
 
-        void update() const {
+        void update() {
             poll_events();
             swap_buffers();
         }
 
         int get_key(int key) const {
-            return glfwGetKey(get_window(), key);
+            return get_window() ? glfwGetKey(get_window(), key) : GLFW_RELEASE;
         }
 
-        static inline void set_vsync(bool val) { glfwSwapInterval(val); }
+        static inline void set_vsync(bool val) { if (!is_headless()) glfwSwapInterval(val); }
 
-        inline void show()  const { glfwShowWindow(get_window()); }
-        inline void hide()  const { glfwHideWindow(get_window()); }
-        inline void focus() const { glfwFocusWindow(get_window()); }
+        inline void set_cursor_mode(int mode) const { if (get_window()) glfwSetInputMode(get_window(), GLFW_CURSOR, mode); }
 
-        inline void set_should_close(bool val) const { glfwSetWindowShouldClose(get_window(), val); }
-        inline bool get_should_close()         const { return glfwWindowShouldClose(get_window()); }
+        inline void show()  const { if (get_window()) glfwShowWindow(get_window()); }
+        inline void hide()  const { if (get_window()) glfwHideWindow(get_window()); }
+        inline void focus() const { if (get_window()) glfwFocusWindow(get_window()); }
 
-        inline void set_pos_cb(GLFWwindowposfun cb)           const { glfwSetWindowPosCallback(get_window(), cb); }
-        inline void set_size_cb(GLFWwindowsizefun cb)         const { glfwSetWindowSizeCallback(get_window(), cb); }
-        inline void set_close_cb(GLFWwindowclosefun cb)       const { glfwSetWindowCloseCallback(get_window(), cb); }
-        inline void set_focus_cb(GLFWwindowfocusfun cb)       const { glfwSetWindowFocusCallback(get_window(), cb); }
-        inline void set_refresh_cb(GLFWwindowrefreshfun cb)   const { glfwSetWindowRefreshCallback(get_window(), cb); }
-        inline void set_maximize_cb(GLFWwindowmaximizefun cb) const { glfwSetWindowMaximizeCallback(get_window(), cb); }
-        inline void set_keys_cb(GLFWkeyfun cb)                const { glfwSetKeyCallback(get_window(), cb); }
-        inline void set_cursor_cb(GLFWcursorposfun cb)        const { glfwSetCursorPosCallback(get_window(), cb); }
-        inline void set_scroll_cb(GLFWscrollfun cb)           const { glfwSetScrollCallback(get_window(), cb); }
-        inline void set_click_cb(GLFWmousebuttonfun cb)       const { glfwSetMouseButtonCallback(get_window(), cb); }
+        inline void set_should_close(bool val) {
+            this->should_close = val;
+            if (get_window())
+                glfwSetWindowShouldClose(get_window(), val);
+        }
 
-        inline void set_name(const char *name) const { glfwSetWindowTitle(get_window(), name); }
-        inline void set_pos(int x, int y)      const { glfwSetWindowPos(get_window(), x, y); }
-        inline std::pair<int, int> get_pos()   const { int x, y; glfwGetWindowPos(get_window(), &x, &y); return {x, y}; }
-        inline void set_size(int w, int h)     const { glfwSetWindowSize(get_window(), w, h); }
-        inline std::pair<int, int> get_size()  const { int w, h; glfwGetWindowSize(get_window(), &w, &h); return {w, h}; }
+        inline bool get_should_close() const {
+            return get_window() ? glfwWindowShouldClose(get_window()) : this->should_close;
+        }
+
+        // Event callbacks are never invoked in headless mode
+        inline void set_pos_cb(GLFWwindowposfun cb)           const { if (get_window()) glfwSetWindowPosCallback(get_window(), cb); }
+        inline void set_size_cb(GLFWwindowsizefun cb)         const { if (get_window()) glfwSetWindowSizeCallback(get_window(), cb); }
+        inline void set_close_cb(GLFWwindowclosefun cb)       const { if (get_window()) glfwSetWindowCloseCallback(get_window(), cb); }
+        inline void set_focus_cb(GLFWwindowfocusfun cb)       const { if (get_window()) glfwSetWindowFocusCallback(get_window(), cb); }
+        inline void set_refresh_cb(GLFWwindowrefreshfun cb)   const { if (get_window()) glfwSetWindowRefreshCallback(get_window(), cb); }
+        inline void set_maximize_cb(GLFWwindowmaximizefun cb) const { if (get_window()) glfwSetWindowMaximizeCallback(get_window(), cb); }
+        inline void set_keys_cb(GLFWkeyfun cb)                const { if (get_window()) glfwSetKeyCallback(get_window(), cb); }
+        inline void set_cursor_cb(GLFWcursorposfun cb)        const { if (get_window()) glfwSetCursorPosCallback(get_window(), cb); }
+        inline void set_scroll_cb(GLFWscrollfun cb)           const { if (get_window()) glfwSetScrollCallback(get_window(), cb); }
+        inline void set_click_cb(GLFWmousebuttonfun cb)       const { if (get_window()) glfwSetMouseButtonCallback(get_window(), cb); }
 
-        inline GLFWwindow *get_window() const { return this->window; }
+        inline void set_name(const char *name) const { if (get_window()) glfwSetWindowTitle(get_window(), name); }
+        inline void set_pos(int x, int y)      const { if (get_window()) glfwSetWindowPos(get_window(), x, y); }
+        inline std::pair<int, int> get_pos()   const {
+            int x = 0, y = 0;
+            if (get_window())
+                glfwGetWindowPos(get_window(), &x, &y);
+            return {x, y};
+        }
+
+        void set_size(int w, int h) {
+            this->w = w, this->h = h;
+            if (get_window())
+                glfwSetWindowSize(get_window(), w, h);
+            else if (this->fbo)
+                set_framebuffer_storage();
+        }
+
+        inline std::pair<int, int> get_size() const {
+            if (!get_window())
+                return {this->w, this->h};
+            int w, h;
+            glfwGetWindowSize(get_window(), &w, &h);
+            return {w, h};
+        }
+
+        inline GlVersion   get_version()     const { return this->ver; }
+        inline GLFWwindow *get_window()      const { return this->window; }
+        inline GLuint      get_framebuffer() const { return this->fbo; } // 0 (the default framebuffer) unless headless
+
+    private:
+        static GlVersion get_requested_version(GlVersion ver) {
+            const char *env = std::getenv("LOGL_GL_VERSION");
+            int maj, min;
+            if (env && (std::sscanf(env, "%d.%d", &maj, &min) == 2))
+                ver.maj = maj, ver.min = min;
+            return ver;
+        }
+
+        static std::size_t get_headless_frames() {
+            const char *env = std::getenv("LOGL_HEADLESS_FRAMES");
+            return env ? std::max(std::atol(env), 1l) : 300;
+        }
+
+        void create_headless_ctx(GlVersion ver) {
+            // Prefer Mesa's surfaceless platform, which needs neither a display server nor a GPU
+            auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+            if (get_platform_display)
+                this->egl_dpy = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            if (this->egl_dpy == EGL_NO_DISPLAY)
+                this->egl_dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+            EGLint maj, min;
+            if ((this->egl_dpy == EGL_NO_DISPLAY) || !eglInitialize(this->egl_dpy, &maj, &min))
+                throw std::runtime_error("Could not initialize EGL display");
+            if (!eglBindAPI(EGL_OPENGL_API))
+                throw std::runtime_error("Could not bind the OpenGL API");
+
+            const EGLint cfg_attribs[] = {
+                EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+                EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                EGL_NONE,
+            };
+            EGLConfig cfg;
+            EGLint nb_cfgs = 0;
+            if (!eglChooseConfig(this->egl_dpy, cfg_attribs, &cfg, 1, &nb_cfgs) || !nb_cfgs)
+                throw std::runtime_error("Could not find an EGL config");
+
+            const EGLint ctx_attribs[] = {
+                EGL_CONTEXT_MAJOR_VERSION,       ver.maj,
+                EGL_CONTEXT_MINOR_VERSION,       ver.min,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, (ver.profile == GLFW_OPENGL_CORE_PROFILE) ?
+                    EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT : EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+                EGL_NONE,
+            };
+            if ((this->egl_ctx = eglCreateContext(this->egl_dpy, cfg, EGL_NO_CONTEXT, ctx_attribs)) == EGL_NO_CONTEXT)
+                throw std::runtime_error("Could not create EGL context");
+            if (!eglMakeCurrent(this->egl_dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, this->egl_ctx))
+                throw std::runtime_error("Could not make EGL context current (EGL_KHR_surfaceless_context missing?)");
+        }
+
+        void create_framebuffer() {
+            glGenFramebuffers(1, &this->fbo);
+            glGenRenderbuffers(2, this->rbos);
+            glBindFramebuffer(GL_FRAMEBUFFER, this->fbo);
+            set_framebuffer_storage();
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,        GL_RENDERBUFFER, this->rbos[0]);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, this->rbos[1]);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                throw std::runtime_error("Could not create offscreen framebuffer");
+            set_viewport(this->w, this->h);
+        }
+
+        void set_framebuffer_storage() const {
+            glBindRenderbuffer(GL_RENDERBUFFER, this->rbos[0]);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, this->w, this->h);
+            glBindRenderbuffer(GL_RENDERBUFFER, this->rbos[1]);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, this->w, this->h);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        }
+
+        void dump_framebuffer(const char *path) const {
+            std::vector<std::uint8_t> pixels((std::size_t)this->w * this->h * 3);
+            GLint prev_fbo;
+            glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prev_fbo);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, this->fbo);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, 0, this->w, this->h, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, prev_fbo);
+
+            std::FILE *fp = std::fopen(path, "wb");
+            if (!fp) {
+                std::cout << "Could not open " << path << '\n';
+                return;
+            }
+            std::fprintf(fp, "P6\n%d %d\n255\n", this->w, this->h);
+            for (int y = this->h - 1; y >= 0; --y) // GL rows are bottom-up
+                std::fwrite(pixels.data() + (std::size_t)y * this->w * 3, 1, (std::size_t)this->w * 3, fp);
+            std::fclose(fp);
+        }
 
     protected:
-        GLFWwindow *window;
+        static inline int s_headless = -1;
+        static inline double s_timestep = 0.0, s_fixed_time = 0.0;
+
+        GLFWwindow *window = nullptr;
+        int w, h;
+        GlVersion ver;
+
+        EGLDisplay egl_dpy = EGL_NO_DISPLAY;
+        EGLContext egl_ctx = EGL_NO_CONTEXT;
+        GLuint fbo = 0, rbos[2] = {};
+        std::size_t nb_frames = 0, max_frames = 0;
+        bool should_close = false;
 };